@@ -8,7 +8,44 @@
 
 /* ----------  ---------- */
 
-#define LZ32_DEBUG 1
+/* Internal asserts and error messages on stderr, enabled with -DLZ32_DEBUG=1 */
+
+#ifndef LZ32_DEBUG
+#define LZ32_DEBUG 0
+#endif
+
+/* Worker threads for batch calls, compiled in with -DLZ32_THREADS=1 (needs pthreads) */
+
+#ifndef LZ32_THREADS
+#define LZ32_THREADS 0
+#endif
+
+/* Hot-path counters, compiled out unless built with -DLZ32_STATS=1 */
+
+#ifndef LZ32_STATS
+#define LZ32_STATS 0
+#endif
+
+/* Hash tables of stateless calls (up to 256 KB) live on the stack; -DLZ32_STACK_TABLES=0 
+   takes them from the heap instead, e.g. for threads, fibers or coroutines with small stacks */
+
+#ifndef LZ32_STACK_TABLES
+#define LZ32_STACK_TABLES 1
+#endif
+
+/* Input size of lz32_compress_page() and the page store, fixed at compile time; 
+   -DLZ32_PAGE_SIZE=16384 for 16 KB pages (a multiple of 16, up to 32 KB) */
+
+#ifndef LZ32_PAGE_SIZE
+#define LZ32_PAGE_SIZE 4096
+#endif
+
+/* lz32d_decompress_fast() checks the frame checksum as well with -DLZ32D_VERIFY_FAST=1; 
+   lz32d_decompress_safe() always does. Unfiltered frames are hashed while decoding. */
+
+#ifndef LZ32D_VERIFY_FAST
+#define LZ32D_VERIFY_FAST 0
+#endif
 
 /* ----------  ---------- */
 
@@ -35,6 +72,8 @@ int lz32_compress_bound ( size_t* src_len, size_t* dst_len );
 
 int lz32_compress_fast ( const void* src_ptr, size_t* src_len, void* dst_ptr, size_t* dst_len );
 
+int lz32_compress_mid ( const void* src_ptr, size_t* src_len, void* dst_ptr, size_t* dst_len );
+
 int lz32_compress_high ( const void* src_ptr, size_t* src_len, void* dst_ptr, size_t* dst_len );
 
 /* ----------  ---------- */
@@ -43,6 +82,366 @@ int lz32_decompress_fast ( const void* src_ptr, size_t src_len, void* dst_ptr, s
 
 int lz32_decompress_safe ( const void* src_ptr, size_t src_len, void* dst_ptr, size_t dst_len );
 
+/* lz32_decompress_safe() that also returns the XXH64 (seed 0) of the output, hashed as 
+   it is written rather than in a second pass; its low 32 bits are the frame checksum */
+
+int lz32_decompress_safe_hash ( const void* src_ptr, size_t src_len, void* dst_ptr, size_t dst_len, unsigned long long* dst_hash );
+
+/* ---------- Split streams ---------- */
+
+/* Leaves the two streams of a block where the compressor writes them instead of packing 
+   them together: the literals, raw tail included, from 'dst_ptr' on and the tokens 
+   (terminator first, last sequence next) at the end of the 'dst_len' capacity, which 
+   spares a copy of the token stream and the padding. They can be stored apart, e.g. 
+   as separate columns, and lz32_decompress_split() takes them apart, with the checks 
+   of lz32_decompress_safe(). Store blocks come out as all literals and a terminator. */
+
+typedef struct lz32_split {
+  void* lit_ptr;
+  size_t lit_len;
+  void* tkn_ptr;                /* 4-byte aligned, as the tokens must be when decoded */
+  size_t tkn_len;
+} lz32_split;
+
+int lz32_compress_split ( const void* src_ptr, size_t* src_len, void* dst_ptr, size_t dst_len, int cmr_lvl, lz32_split* spl );
+
+int lz32_decompress_split ( const void* lit_ptr, size_t lit_len, const void* tkn_ptr, size_t tkn_len, void* dst_ptr, size_t dst_len );
+
+/* ---------- Compression parameters ---------- */
+
+/* Tunes the engine behind a block: a chain_log of 0 selects the single-probe fast 
+   engine, otherwise the chain engine searches a window of 2^chain_log bytes, 
+   following at most 'search_depth' candidates per position (0 follows all). Blocks 
+   decode as usual. lz32_params_default() picks a tuned set for a level and an 
+   expected block size (0 if unknown); those sets run as specialised code paths. */
+
+#define LZ32_PARAM_HASH_LOG_MIN   10
+#define LZ32_PARAM_HASH_LOG_MAX   20
+#define LZ32_PARAM_CHAIN_LOG_MIN  10
+#define LZ32_PARAM_CHAIN_LOG_MAX  16
+#define LZ32_PARAM_MIN_MATCH_MIN  5
+#define LZ32_PARAM_MIN_MATCH_MAX  64
+
+typedef struct lz32_params {
+  unsigned hash_log;            /* hash table entries, log2 */
+  unsigned chain_log;           /* chain table entries and window size, log2 */
+  unsigned search_depth;
+  unsigned min_match;
+  size_t block_size;            /* input taken per call, 0 takes all that fits */
+} lz32_params;
+
+int lz32_params_default ( lz32_params* prm, int cmr_lvl, size_t blk_len );
+
+int lz32_compress_params ( const lz32_params* prm, const void* src_ptr, size_t* src_len, void* dst_ptr, size_t* dst_len );
+
+/* ---------- Memory allocation ---------- */
+
+/* Workspaces take their tables from an allocator; 'free_fn' gets back the length 
+   passed to 'alloc_fn'. The arena hands out 64-byte aligned pieces of a caller buffer 
+   and only reclaims the last one (or everything on reset). The huge-page allocator 
+   rounds to 2 MB pages, the NUMA allocator binds pages to 'node' (< 0: the node the 
+   calling thread runs on); both fall back to plain pages where the system declines. */
+
+typedef struct lz32_alloc {
+  void* (*alloc_fn) ( void* ctx, size_t len );
+  void (*free_fn) ( void* ctx, void* ptr, size_t len );
+  void* ctx;
+} lz32_alloc;
+
+typedef struct lz32_arena {
+  char* buf_ptr;
+  size_t buf_len;
+  size_t buf_pos;
+} lz32_arena;
+
+int lz32_alloc_default ( lz32_alloc* alc );
+
+int lz32_alloc_arena ( lz32_alloc* alc, lz32_arena* are, void* buf_ptr, size_t buf_len );
+
+void lz32_arena_reset ( lz32_arena* are );
+
+int lz32_alloc_hugepage ( lz32_alloc* alc );
+
+int lz32_alloc_numa ( lz32_alloc* alc, int node );
+
+/* ---------- Compression workspace ---------- */
+
+/* Holds the tables of the fast and high engines between calls, so repeated blocks 
+   skip the table setup and nothing lands on the stack. Grows to the largest 
+   lz32_params geometry seen. One workspace per thread; the fields are private. */
+
+typedef struct lz32_cwork {
+  lz32_alloc alc;
+  void* tbl_ptr;
+  size_t tbl_len;
+  unsigned htb_base;
+  int htb_algo;
+  unsigned htb_log, ctb_log;
+} lz32_cwork;
+
+int lz32_cwork_init ( lz32_cwork* wrk, const lz32_alloc* alc );
+
+void lz32_cwork_free ( lz32_cwork* wrk );
+
+/* Compresses at 'cmr_lvl', or with 'prm' when it is not NULL */
+
+int lz32_compress_cwork ( lz32_cwork* wrk, int cmr_lvl, const lz32_params* prm, 
+                          const void* src_ptr, size_t* src_len, void* dst_ptr, size_t* dst_len );
+
+/* ---------- Batch compression ---------- */
+
+/* Levels from LZ32_LEVEL_MID up to 3 run the engine of lz32_compress_mid(), at about 
+   70% of the speed of the fast level */
+
+#define LZ32_LEVEL_FAST 1
+#define LZ32_LEVEL_MID  2
+#define LZ32_LEVEL_HIGH 9
+
+/* 'src_len' and 'dst_len' hold the input size and the block capacity on entry, and the 
+   consumed input and the block size on return, as for lz32_compress_fast(). Each thread 
+   takes its tables from 'alc' (NULL: malloc). 'thr_cnt' is capped at the item count 
+   and at LZ32_BATCH_THREADS_MAX. */
+
+#define LZ32_BATCH_THREADS_MAX 64
+
+typedef struct lz32_batch_item {
+  const void* src_ptr;
+  size_t src_len;
+  void* dst_ptr;
+  size_t dst_len;
+  int res_val;
+} lz32_batch_item;
+
+int lz32_compress_batch ( lz32_batch_item* item_ptr, size_t item_cnt, const lz32_alloc* alc, int cmr_lvl, int thr_cnt );
+
+/* For decompression 'src_len' is the block size and 'dst_len' the raw size; blocks are 
+   decoded with the checks of lz32_decompress_safe(), several at a time. */
+
+int lz32_decompress_batch ( lz32_batch_item* item_ptr, size_t item_cnt );
+
+/* ---------- Streaming decompression ---------- */
+
+/* Decodes one block of 'blk_len' bytes into its 'raw_len' bytes in constant memory: a 
+   64 KB history ring and two 8 KB input buffers, taken from 'alc' (NULL: malloc). 
+   Literals are read from the front of the block and tokens from its back, so the 
+   block is read through 'read_fn' at offsets from 'blk_pos'; with a NULL 'read_fn', 
+   'read_ctx' points to the block itself. lz32_dstream_read() fills up to '*dst_len' 
+   bytes and returns how many it wrote, 0 once the block is done. It checks like 
+   lz32_decompress_safe(); the call that writes the last byte also checks the rest of 
+   the token stream, and once it has failed it keeps failing. */
+
+typedef int (*lz32_read_fn) ( void* ctx, unsigned long long pos, void* buf, size_t len );
+
+typedef struct lz32_dstream {
+  lz32_alloc alc;
+  lz32_read_fn read_fn;
+  void* read_ctx;
+  unsigned long long blk_pos;
+  size_t blk_len, raw_len;
+  size_t lit_pos, lit_beg, lit_end;
+  size_t tkn_pos, tkn_beg, tkn_end;
+  size_t out_pos;
+  size_t lit_rem, mtc_rem, mtc_off;
+  int state, res_val;
+  char* ring_ptr;
+  char* lit_buf;
+  char* tkn_buf;
+} lz32_dstream;
+
+int lz32_dstream_init ( lz32_dstream* ds, const lz32_alloc* alc, lz32_read_fn read_fn, void* read_ctx, 
+                        unsigned long long blk_pos, size_t blk_len, size_t raw_len );
+
+int lz32_dstream_read ( lz32_dstream* ds, void* dst_ptr, size_t* dst_len );
+
+void lz32_dstream_free ( lz32_dstream* ds );
+
+/* ---------- Chained blocks ---------- */
+
+/* Compresses a stream chunk by chunk into blocks whose matches may reach 64 KB back 
+   into the chunks before them, so small chunks compress about as well as one large 
+   block. Each side keeps a window of 64 KB of history plus 'chunk_max' bytes, taken 
+   from 'alc' (NULL: malloc); levels 4-9 compress as level 3, the bucketed engine. 
+   lz32_cchain_compress() takes up to 'chunk_max' bytes from '*src_len' and needs a 
+   '*dst_len' of at least lz32_compress_bound() of them. The blocks must be decoded in 
+   the same order by an lz32_dchain with at least the same 'chunk_max'; 
+   lz32_dchain_decompress() points '*dst_ptr' at the 'raw_len' decoded bytes inside 
+   its window, valid until the next call. After a failed block the chain keeps failing. */
+
+typedef struct lz32_cchain {
+  lz32_cwork wrk;
+  int cmr_lvl;
+  char* win_ptr;
+  size_t win_len, win_cap;
+} lz32_cchain;
+
+int lz32_cchain_init ( lz32_cchain* cc, const lz32_alloc* alc, int cmr_lvl, size_t chunk_max );
+
+int lz32_cchain_compress ( lz32_cchain* cc, const void* src_ptr, size_t* src_len, void* dst_ptr, size_t* dst_len );
+
+void lz32_cchain_free ( lz32_cchain* cc );
+
+typedef struct lz32_dchain {
+  lz32_alloc alc;
+  char* win_ptr;
+  size_t win_len, win_cap;
+  int res_val;
+} lz32_dchain;
+
+int lz32_dchain_init ( lz32_dchain* dc, const lz32_alloc* alc, size_t chunk_max );
+
+int lz32_dchain_decompress ( lz32_dchain* dc, const void* src_ptr, size_t src_len, size_t raw_len, const void** dst_ptr );
+
+void lz32_dchain_free ( lz32_dchain* dc );
+
+/* ---------- Page compression ---------- */
+
+/* lz32_compress_page() compresses exactly LZ32_PAGE_SIZE bytes into a block of up to 
+   LZ32_PAGE_BOUND bytes ('*dst_len': the capacity on entry, the block size on return), 
+   with the fast engine on a small stack table, in 3-8% fewer cycles than 
+   lz32_compress_fast() takes for a 4 KB page. Its blocks are ordinary lz32 blocks; 
+   lz32_decompress_page() is lz32_decompress_safe() for any block of a LZ32_PAGE_SIZE 
+   raw size. */
+
+#define LZ32_PAGE_BOUND (LZ32_PAGE_SIZE + 16)
+
+int lz32_compress_page ( const void* src_ptr, void* dst_ptr, size_t* dst_len );
+
+int lz32_decompress_page ( const void* src_ptr, size_t src_len, void* dst_ptr );
+
+/* A compressed page cache: up to 'ent_max' pages under 64-bit keys, held in at most 
+   'mem_max' bytes of four-page slabs from 'alc' (NULL: malloc). Each slab is cut into 
+   slots of one size class, in steps of LZ32_PSTORE_CLASS_STEP bytes; pages that stay 
+   above 3/4 of their size compressed are kept raw. A put replaces the page under its 
+   key and evicts least recently used pages when it finds no free slot or entry. 
+   lz32_pstore_get() decodes the page into 'dst_ptr' and sets '*dst_len' (at least 
+   LZ32_PAGE_SIZE on entry) to LZ32_PAGE_SIZE, or to 0 when the key is not, or no 
+   longer, in the store. 'pg_cnt', 'mem_used' (bytes of slots in use) and 'evicted' may 
+   be read; the other fields are private. Not thread-safe. */
+
+#define LZ32_PSTORE_CLASS_STEP 128
+#define LZ32_PSTORE_CLASSES ((LZ32_PAGE_SIZE + LZ32_PSTORE_CLASS_STEP - 1) / LZ32_PSTORE_CLASS_STEP)
+
+typedef struct lz32_pstore {
+  lz32_alloc alc;
+  struct lz32_pstore_ent* ent_ptr;
+  struct lz32_pstore_slab* slab_ptr;
+  unsigned* bkt_ptr;
+  size_t ent_max, slab_max, slab_cnt, bkt_mask;
+  unsigned ent_free, slab_free, lru_head, lru_tail;
+  unsigned cls_head[LZ32_PSTORE_CLASSES];
+  size_t pg_cnt, mem_used;
+  unsigned long long evicted;
+} lz32_pstore;
+
+int lz32_pstore_init ( lz32_pstore* ps, const lz32_alloc* alc, size_t mem_max, size_t ent_max );
+
+int lz32_pstore_put ( lz32_pstore* ps, unsigned long long key, const void* src_ptr );
+
+int lz32_pstore_get ( lz32_pstore* ps, unsigned long long key, void* dst_ptr, size_t* dst_len );
+
+void lz32_pstore_drop ( lz32_pstore* ps, unsigned long long key );
+
+void lz32_pstore_free ( lz32_pstore* ps );
+
+/* ---------- Adaptive compression ---------- */
+
+/* Picks the store, fast or high engine per block so that compression keeps up with 
+   'tgt_mbps' on average and/or stays under 'tgt_usec' per block (0 disables either), 
+   backing off under load and spending idle time on ratio. Blocks decode as usual. 
+   One state per stream; it is not shared between threads. Tables come from 'alc' 
+   (NULL: malloc). */
+
+#define LZ32_ENGINE_STORE 0
+#define LZ32_ENGINE_FAST  1
+#define LZ32_ENGINE_HIGH  2
+
+typedef struct lz32_adapt {
+  double tgt_mbps;
+  double tgt_usec;
+  double unit_nspb;             /* ns per byte of the fast engine under the current load */
+  double cost_rel[3];           /* engine time relative to the fast engine */
+  double ratio_eng[3];          /* recent block size / raw size per engine */
+  double ratio_last;
+  double slack_ns;              /* time gained (or lost) against 'tgt_mbps' */
+  unsigned store_run, fast_run;
+  int engine_last;
+  unsigned long long blocks[3];
+  lz32_cwork wrk;
+} lz32_adapt;
+
+int lz32_adapt_init ( lz32_adapt* ada, const lz32_alloc* alc, double tgt_mbps, double tgt_usec );
+
+void lz32_adapt_free ( lz32_adapt* ada );
+
+int lz32_compress_adaptive ( lz32_adapt* ada, const void* src_ptr, size_t* src_len, void* dst_ptr, size_t* dst_len );
+
+/* ---------- Compressibility estimate ---------- */
+
+/* Predicts the raw size / block size ratio of the fast and high levels from samples of 
+   the input (1/8 of it, at least 64 KB and at most 512 KB), and suggests the store 
+   engine when neither would gain, or the high one when it would gain clearly. The fast 
+   ratio is typically within 6% and the high one within 12% (mostly low) of the actual. 
+   Below 256 KB the high level is not modelled: 'ratio_high' equals 'ratio_fast' and the 
+   high engine is never suggested. Measured cost: about one fast compression of the 
+   input up to 64 KB, which is parsed whole, 30-95% of it from 128 KB to 4 MB, and a 
+   falling share above, where the sample stays at 512 KB. */
+
+typedef struct lz32_estimate_info {
+  double ratio_fast;
+  double ratio_high;
+  size_t sampled;               /* input bytes the prediction is based on */
+  int engine;                   /* LZ32_ENGINE_STORE, _FAST or _HIGH */
+} lz32_estimate_info;
+
+int lz32_estimate ( const void* src_ptr, size_t src_len, lz32_estimate_info* est );
+
+/* ---------- Delta compression ---------- */
+
+/* Delta blocks encode a buffer against a reference (e.g. the previous version of it) 
+   that the decoder must supply unchanged; matches may point anywhere in it. The 
+   reference index is built once by lz32_delta_ref_init() and is read-only afterwards. 
+   Delta blocks are not lz32 blocks; the destination must hold lz32_delta_bound() bytes. */
+
+#define LZ32_DELTA_REF_MAX ((size_t)3 << 30)
+
+typedef struct lz32_delta_ref {
+  const void* ref_ptr;
+  size_t ref_len;
+  void* idx_ptr;
+  unsigned idx_log;
+} lz32_delta_ref;
+
+int lz32_delta_ref_init ( lz32_delta_ref* ref, const void* ref_ptr, size_t ref_len );
+
+void lz32_delta_ref_free ( lz32_delta_ref* ref );
+
+int lz32_delta_bound ( size_t* src_len, size_t* dst_len );
+
+int lz32_compress_delta ( const lz32_delta_ref* ref, const void* src_ptr, size_t* src_len, void* dst_ptr, size_t* dst_len );
+
+int lz32_decompress_delta ( const void* ref_ptr, size_t ref_len, const void* src_ptr, size_t src_len, void* dst_ptr, size_t dst_len );
+
+/* ---------- Data filters ---------- */
+
+/* A filter ID combines a mode with the element size (1, 2, 4 or 8 bytes); 
+   LZ32_FILTER_NONE is the byte shuffle of 1-byte elements, which changes nothing. 
+   Delta and XOR shuffle the bytes after differencing. Source and destination 
+   must not overlap. */
+
+#define LZ32_FILTER_SHUFFLE     0
+#define LZ32_FILTER_BITSHUFFLE  1
+#define LZ32_FILTER_DELTA       2
+#define LZ32_FILTER_XOR         3
+
+#define LZ32_FILTER_ID(mode, elm_len) (((mode) << 2) | (((elm_len) >= 2) + ((elm_len) >= 4) + ((elm_len) >= 8)))
+
+#define LZ32_FILTER_NONE 0
+#define LZ32_FILTER_MAX 15
+
+int lz32_filter_encode ( int flt_id, const void* src_ptr, void* dst_ptr, size_t len );
+
+int lz32_filter_decode ( int flt_id, const void* src_ptr, void* dst_ptr, size_t len );
+
 /* ----------  ---------- */
 
 int lz32d_compress_bound ( size_t* src_len, size_t* dst_len );
@@ -51,6 +450,10 @@ int lz32d_compress_fast ( const void* src_ptr, size_t* src_len, void* dst_ptr, s
 
 int lz32d_compress_high ( const void* src_ptr, size_t* src_len, void* dst_ptr, size_t* dst_len );
 
+/* Filters the data (see LZ32_FILTER_ID) before compressing it; the decompressors undo it */
+
+int lz32d_compress_filter ( const void* src_ptr, size_t* src_len, void* dst_ptr, size_t* dst_len, int cmr_lvl, int flt_id );
+
 /* ----------  ---------- */
 
 //int xxh64_hash_low32 ( const void* src_ptr, size_t src_len, void* dst_ptr );
@@ -61,6 +464,49 @@ int lz32d_decompress_fast ( const void* src_ptr, size_t* src_len, void* dst_ptr,
 
 int lz32d_decompress_safe ( const void* src_ptr, size_t* src_len, void* dst_ptr, size_t* dst_len );
 
+/* A filtered frame decodes into scratch memory of its raw size before it is unfiltered 
+   into 'dst_ptr'. The plain forms allocate it for every filtered frame; the _tmp forms 
+   use the 'tmp_len' bytes at 'tmp_ptr' and fail with LZ32_EINVAL when they are short. */
+
+int lz32d_decompress_fast_tmp ( const void* src_ptr, size_t* src_len, void* dst_ptr, size_t* dst_len, void* tmp_ptr, size_t tmp_len );
+
+int lz32d_decompress_safe_tmp ( const void* src_ptr, size_t* src_len, void* dst_ptr, size_t* dst_len, void* tmp_ptr, size_t tmp_len );
+
+/* ---------- Statistics ---------- */
+
+#define LZ32_STATS_BUCKETS 17
+
+/* Histogram bucket 'k' counts values in [2^(k-1), 2^k), bucket 0 counts zeros. */
+
+typedef struct lz32_stats_seq {
+  unsigned long long blocks;
+  unsigned long long tokens;
+  unsigned long long filler_tokens;
+  unsigned long long literals;
+  unsigned long long matched;
+  unsigned long long lit_len_hist[LZ32_STATS_BUCKETS];
+  unsigned long long mtc_len_hist[LZ32_STATS_BUCKETS];
+  unsigned long long mtc_off_hist[LZ32_STATS_BUCKETS];
+} lz32_stats_seq;
+
+typedef struct lz32_stats {
+  unsigned long long positions;
+  unsigned long long hash_probes;
+  unsigned long long hash_hits;
+  unsigned long long chain_steps;
+  unsigned long long chain_hist[LZ32_STATS_BUCKETS];
+  unsigned long long store_blocks;
+  lz32_stats_seq cmp;
+  lz32_stats_seq dec;
+} lz32_stats;
+
+int lz32_stats_enabled ( void );
+
+void lz32_stats_reset ( lz32_stats* sts );
+
+/* Attaches 'sts' to the calling thread; NULL detaches. Returns the previous block. */
+
+lz32_stats* lz32_stats_attach ( lz32_stats* sts );
 
 
 
@@ -0,0 +1,684 @@
+#ifndef LZ32_HPP
+#define LZ32_HPP
+
+/* ---------- LZ32 C++ interface ---------- */
+
+/*
+ * Header-only C++20 layer over the C library: compile lz32.c as C and link it in.
+ *
+ *   lz32::compress<Level> (src, dst)     block into a caller span, level fixed at compile time
+ *   lz32::compress<Level> (src, buf)     block into an lz32::buffer, grown only when too small
+ *   lz32::decompress (blk, dst)          checked decoding, as lz32_decompress_safe()
+ *   lz32::context                        owns an lz32_cwork, tables from a memory_resource
+ *   lz32::compress_stream<Level> (in)    coroutine: raw pieces in, chained framed blocks out
+ *   lz32::decompress_stream (in)         coroutine: framed blocks in, raw chunks out
+ *
+ * Errors come back as lz32::result<T>: std::expected<T, lz32::errc> where the library
+ * has it (C++23), a minimal stand-in with the same members otherwise. Nothing here
+ * allocates unless a buffer or a context has to grow.
+ */
+
+extern "C" {
+#include "lz32.h"
+}
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <memory_resource>
+#include <new>
+#include <span>
+#include <type_traits>
+#include <utility>
+
+#if __has_include(<coroutine>) && defined (__cpp_impl_coroutine)
+#include <coroutine>
+#define LZ32_HPP_COROUTINES 1
+#endif
+
+#if __has_include(<expected>)
+#include <expected>
+#endif
+
+
+namespace lz32 {
+
+
+/* ---------- Errors ---------- */
+
+
+enum class errc : int {
+  invalid = LZ32_EINVAL,
+  data    = LZ32_EDATA,
+  memory  = LZ32_EUNKNOWN + 1,          /* a buffer or a context could not grow */
+  unknown = LZ32_EUNKNOWN,
+};
+
+inline const char* message ( errc err ) {
+  if (err == errc::memory) return "out of memory";
+  return lz32_error_string (static_cast<int> (err));
+}
+
+
+#if defined (__cpp_lib_expected) && (__cpp_lib_expected >= 202202L)
+
+template <class T> using result = std::expected<T, errc>;
+
+inline auto fail ( errc err ) { return std::unexpected<errc> (err); }
+
+#else
+
+struct failure {
+  errc err;
+};
+
+inline failure fail ( errc err ) { return failure { err }; }
+
+template <class T>
+class result {
+public:
+  result ( const T& val ) : val_ (val), err_ (), ok_ (true) {}
+  result ( T&& val ) : val_ (std::move (val)), err_ (), ok_ (true) {}
+  result ( failure f ) : val_ (), err_ (f.err), ok_ (false) {}
+
+  bool has_value () const noexcept { return ok_; }
+  explicit operator bool () const noexcept { return ok_; }
+
+  T& value () & { return val_; }
+  const T& value () const & { return val_; }
+  T&& value () && { return std::move (val_); }
+
+  T& operator* () & { return val_; }
+  const T& operator* () const & { return val_; }
+  T* operator-> () { return &(val_); }
+  const T* operator-> () const { return &(val_); }
+
+  errc error () const noexcept { return err_; }
+
+  template <class U> T value_or ( U&& alt ) const & { return ok_ ? val_ : static_cast<T> (std::forward<U> (alt)); }
+
+private:
+  T val_;
+  errc err_;
+  bool ok_;
+};
+
+#endif
+
+
+namespace detail {
+
+inline errc to_errc ( int res_val ) {
+  switch (res_val) {
+    case LZ32_EINVAL: return errc::invalid;
+    case LZ32_EDATA: return errc::data;
+    default: return errc::unknown;
+  }
+}
+
+/* lz32_alloc over a memory_resource, 64-byte aligned for the tables */
+
+inline void* resource_alloc ( void* ctx, std::size_t len ) {
+  try {
+    return static_cast<std::pmr::memory_resource*> (ctx)->allocate (len, 64);
+  } catch (const std::bad_alloc&) {
+    return nullptr;
+  }
+}
+
+inline void resource_free ( void* ctx, void* ptr, std::size_t len ) {
+  static_cast<std::pmr::memory_resource*> (ctx)->deallocate (ptr, len, 64);
+}
+
+inline lz32_alloc resource_allocator ( std::pmr::memory_resource* mr ) noexcept {
+  return lz32_alloc { &(resource_alloc), &(resource_free), mr };
+}
+
+}
+
+
+/* ---------- Levels ---------- */
+
+/*
+ * A level picks the engine at compile time: 1 fast, 2..3 bucketed, 4..9 chain search,
+ * as the C library maps cmr_lvl.
+ */
+
+inline constexpr int level_fast = LZ32_LEVEL_FAST;
+inline constexpr int level_mid  = LZ32_LEVEL_MID;
+inline constexpr int level_high = LZ32_LEVEL_HIGH;
+
+template <int Level>
+concept valid_level = (Level >= 1) && (Level <= 9);
+
+namespace detail {
+
+template <int Level>
+constexpr auto engine () {
+  if constexpr (Level >= 4) return &lz32_compress_high;
+  else if constexpr (Level >= 2) return &lz32_compress_mid;
+  else return &lz32_compress_fast;
+}
+
+}
+
+
+/* ---------- Sizes ---------- */
+
+
+/* largest block a raw input can become; inputs over LZ32_RAW_SIZE_MAX go in pieces */
+
+constexpr std::size_t compress_bound ( std::size_t raw_len ) noexcept {
+  if (raw_len > LZ32_RAW_SIZE_MAX) raw_len = LZ32_RAW_SIZE_MAX;
+  return (raw_len + 4 + 15) & ~static_cast<std::size_t> (15);
+}
+
+struct compressed {
+  std::size_t consumed;                 /* input bytes taken into the block */
+  std::size_t size;                     /* block bytes written */
+};
+
+
+/* ---------- Output buffer ---------- */
+
+/*
+ * Bytes from a memory_resource, 16-byte aligned as blocks and the wild copies want;
+ * the capacity only grows, so a reused buffer stops allocating.
+ */
+
+class buffer {
+public:
+  static constexpr std::size_t alignment = 16;
+
+  explicit buffer ( std::pmr::memory_resource* mr = std::pmr::get_default_resource () ) noexcept : mr_ (mr) {}
+
+  buffer ( std::size_t cap, std::pmr::memory_resource* mr = std::pmr::get_default_resource () ) : mr_ (mr) {
+    reserve (cap);
+  }
+
+  buffer ( buffer&& other ) noexcept
+    : mr_ (other.mr_), ptr_ (std::exchange (other.ptr_, nullptr)),
+      len_ (std::exchange (other.len_, 0)), cap_ (std::exchange (other.cap_, 0)) {}
+
+  buffer& operator= ( buffer&& other ) noexcept {
+    if (this != &(other)) {
+      release ();
+      mr_ = other.mr_;
+      ptr_ = std::exchange (other.ptr_, nullptr);
+      len_ = std::exchange (other.len_, 0);
+      cap_ = std::exchange (other.cap_, 0);
+    }
+    return *this;
+  }
+
+  buffer ( const buffer& ) = delete;
+  buffer& operator= ( const buffer& ) = delete;
+
+  ~buffer () { release (); }
+
+  /* throws std::bad_alloc as the resource does; the compress calls turn it into errc::memory.
+     the first size() bytes move to the new storage */
+
+  void reserve ( std::size_t cap ) {
+    if (cap <= cap_) return;
+    cap = (cap + (alignment - 1)) & ~(alignment - 1);
+    std::byte* ptr = static_cast<std::byte*> (mr_->allocate (cap, alignment));
+    std::size_t len = len_;
+    if (len != 0) std::memcpy ( ptr, ptr_, len );
+    release ();
+    ptr_ = ptr;
+    len_ = len;
+    cap_ = cap;
+  }
+
+  void resize ( std::size_t len ) { reserve (len); len_ = len; }
+  void clear () noexcept { len_ = 0; }
+
+  std::byte* data () noexcept { return ptr_; }
+  const std::byte* data () const noexcept { return ptr_; }
+  std::size_t size () const noexcept { return len_; }
+  std::size_t capacity () const noexcept { return cap_; }
+  std::pmr::memory_resource* resource () const noexcept { return mr_; }
+
+  std::span<std::byte> span () noexcept { return { ptr_, len_ }; }
+  std::span<const std::byte> span () const noexcept { return { ptr_, len_ }; }
+
+private:
+  void release () noexcept {
+    if (ptr_ != nullptr) mr_->deallocate (ptr_, cap_, alignment);
+    ptr_ = nullptr;
+    len_ = cap_ = 0;
+  }
+
+  std::pmr::memory_resource* mr_;
+  std::byte* ptr_ = nullptr;
+  std::size_t len_ = 0;
+  std::size_t cap_ = 0;
+};
+
+
+/* ---------- Block compression ---------- */
+
+
+/* 'dst' must be 4-byte aligned; returns how much input went in and the block size */
+
+template <int Level> requires valid_level<Level>
+result<compressed> compress ( std::span<const std::byte> src, std::span<std::byte> dst ) {
+  std::size_t slen = src.size (), dlen = dst.size ();
+  int res = detail::engine<Level> () ( src.data (), &(slen), dst.data (), &(dlen) );
+  if (res != LZ32_SUCCESS) return fail (detail::to_errc (res));
+  return compressed { slen, dlen };
+}
+
+
+/* sizes 'out' to the block, growing it to compress_bound() first if needed */
+
+template <int Level> requires valid_level<Level>
+result<compressed> compress ( std::span<const std::byte> src, buffer& out ) {
+  try {
+    out.resize (compress_bound (src.size ()));
+  } catch (const std::bad_alloc&) {
+    return fail (errc::memory);
+  }
+  auto res = compress<Level> (src, out.span ());
+  out.resize ((res.has_value ()) ? res->size : 0);
+  return res;
+}
+
+
+/* ---------- Block decompression ---------- */
+
+/*
+ * 'dst.size()' is the raw size the block was made from, as the C calls take it;
+ * the block must be 4-byte aligned. Returns the bytes written.
+ */
+
+inline result<std::size_t> decompress ( std::span<const std::byte> blk, std::span<std::byte> dst ) {
+  int res = lz32_decompress_safe ( blk.data (), blk.size (), dst.data (), dst.size () );
+  if (res != LZ32_SUCCESS) return fail (detail::to_errc (res));
+  return dst.size ();
+}
+
+/* trusted blocks only: lz32_decompress_fast() skips the bounds checks */
+
+inline result<std::size_t> decompress_unchecked ( std::span<const std::byte> blk, std::span<std::byte> dst ) {
+  int res = lz32_decompress_fast ( blk.data (), blk.size (), dst.data (), dst.size () );
+  if (res != LZ32_SUCCESS) return fail (detail::to_errc (res));
+  return dst.size ();
+}
+
+/* checked decoding that also returns the XXH64 (seed 0) of the output */
+
+inline result<unsigned long long> decompress_hash ( std::span<const std::byte> blk, std::span<std::byte> dst ) {
+  unsigned long long hsh = 0;
+  int res = lz32_decompress_safe_hash ( blk.data (), blk.size (), dst.data (), dst.size (), &(hsh) );
+  if (res != LZ32_SUCCESS) return fail (detail::to_errc (res));
+  return hsh;
+}
+
+
+/* ---------- Compression context ---------- */
+
+/*
+ * Keeps the engine tables between blocks (see lz32_cwork), taken from 'mr' with
+ * 64-byte alignment. Move-only; one context per thread.
+ */
+
+class context {
+public:
+  explicit context ( std::pmr::memory_resource* mr = std::pmr::get_default_resource () ) noexcept {
+    lz32_alloc alc = detail::resource_allocator (mr);
+    lz32_cwork_init ( &(wrk_), &(alc) );
+  }
+
+  /* the moved-from context keeps its allocator and starts over with no tables */
+
+  context ( context&& other ) noexcept : wrk_ (other.wrk_) {
+    lz32_cwork_init ( &(other.wrk_), &(wrk_.alc) );
+  }
+
+  context& operator= ( context&& other ) noexcept {
+    if (this != &(other)) {
+      lz32_cwork_free (&(wrk_));
+      wrk_ = other.wrk_;
+      lz32_cwork_init ( &(other.wrk_), &(wrk_.alc) );
+    }
+    return *this;
+  }
+
+  context ( const context& ) = delete;
+  context& operator= ( const context& ) = delete;
+
+  ~context () { lz32_cwork_free (&(wrk_)); }
+
+  template <int Level> requires valid_level<Level>
+  result<compressed> compress ( std::span<const std::byte> src, std::span<std::byte> dst ) {
+    std::size_t slen = src.size (), dlen = dst.size ();
+    int res = lz32_compress_cwork ( &(wrk_), Level, nullptr, src.data (), &(slen), dst.data (), &(dlen) );
+    if (res != LZ32_SUCCESS) return fail (detail::to_errc (res));
+    return compressed { slen, dlen };
+  }
+
+  template <int Level> requires valid_level<Level>
+  result<compressed> compress ( std::span<const std::byte> src, buffer& out ) {
+    try {
+      out.resize (compress_bound (src.size ()));
+    } catch (const std::bad_alloc&) {
+      return fail (errc::memory);
+    }
+    auto res = compress<Level> (src, out.span ());
+    out.resize ((res.has_value ()) ? res->size : 0);
+    return res;
+  }
+
+  lz32_cwork* native () noexcept { return &(wrk_); }
+
+private:
+  lz32_cwork wrk_;
+};
+
+
+#if defined (LZ32_HPP_COROUTINES)
+
+
+/* ---------- Async generator ---------- */
+
+/*
+ * A lazy coroutine sequence the consumer pulls with 'co_await gen.next ()', which gives
+ * a pointer to the next value, or nullptr once the generator has returned. The body may
+ * co_await anything between its co_yields; control passes by symmetric transfer, so the
+ * generator runs on whatever thread resumed it and needs no executor of its own. A
+ * yielded value lives until the next call to next(); an exception leaving the body is
+ * rethrown from that next().
+ */
+
+template <class T>
+class async_generator {
+public:
+  struct promise_type;
+  using handle = std::coroutine_handle<promise_type>;
+
+  struct transfer {
+    bool await_ready () const noexcept { return false; }
+    std::coroutine_handle<> await_suspend ( handle gen ) noexcept { return gen.promise ().cnt_; }
+    void await_resume () const noexcept {}
+  };
+
+  struct promise_type {
+    const T* val_ = nullptr;
+    std::coroutine_handle<> cnt_;
+    std::exception_ptr exc_;
+
+    async_generator get_return_object () noexcept { return async_generator { handle::from_promise (*this) }; }
+    std::suspend_always initial_suspend () const noexcept { return {}; }
+    transfer final_suspend () const noexcept { return {}; }
+    transfer yield_value ( const T& val ) noexcept { val_ = std::addressof (val); return {}; }
+    void return_void () const noexcept {}
+    void unhandled_exception () noexcept { exc_ = std::current_exception (); }
+  };
+
+  struct next_awaiter {
+    handle gen_;
+
+    bool await_ready () const noexcept { return (!gen_) || gen_.done (); }
+
+    std::coroutine_handle<> await_suspend ( std::coroutine_handle<> cnt ) noexcept {
+      gen_.promise ().cnt_ = cnt;
+      return gen_;
+    }
+
+    const T* await_resume () {
+      if (!gen_) return nullptr;
+      if (gen_.promise ().exc_) std::rethrow_exception (std::exchange (gen_.promise ().exc_, nullptr));
+      return (gen_.done ()) ? nullptr : gen_.promise ().val_;
+    }
+  };
+
+  async_generator () noexcept = default;
+  async_generator ( async_generator&& other ) noexcept : coro_ (std::exchange (other.coro_, nullptr)) {}
+
+  async_generator& operator= ( async_generator&& other ) noexcept {
+    if (this != &(other)) {
+      if (coro_) coro_.destroy ();
+      coro_ = std::exchange (other.coro_, nullptr);
+    }
+    return *this;
+  }
+
+  async_generator ( const async_generator& ) = delete;
+  async_generator& operator= ( const async_generator& ) = delete;
+
+  ~async_generator () { if (coro_) coro_.destroy (); }
+
+  next_awaiter next () noexcept { return next_awaiter { coro_ }; }
+
+private:
+  explicit async_generator ( handle coro ) noexcept : coro_ (coro) {}
+
+  handle coro_ = nullptr;
+};
+
+
+/* ---------- Chained streams ---------- */
+
+/*
+ * Each output chunk of compress_stream() is one frame, [ raw size:4 | block size:4 |
+ * lz32 block ] with little-endian sizes, compressed with lz32_cchain so its matches
+ * reach 64 KB into the chunks before it. decompress_stream() takes the frames cut up
+ * any way and yields each chunk's raw bytes from its lz32_dchain window.
+ *
+ * Memory per stream stays near 64 KB + 2 * chunk_size on either side, plus the engine
+ * tables when compressing; 'chunk_size' on the decoding side must be at least the
+ * encoder's. Levels 4..9 compress as level 3, the chain-search engine keeps no history.
+ * A generator cannot return an error, so failures are thrown from next() as
+ * lz32::stream_error (std::bad_alloc as is).
+ */
+
+struct stream_options {
+  std::size_t chunk_size = 65536;       /* raw bytes per block at most */
+  bool flush_each = false;              /* close a block at the end of every input piece */
+  std::pmr::memory_resource* resource = std::pmr::get_default_resource ();
+};
+
+class stream_error : public std::exception {
+public:
+  explicit stream_error ( errc err ) noexcept : err_ (err) {}
+
+  errc code () const noexcept { return err_; }
+  const char* what () const noexcept override { return message (err_); }
+
+private:
+  errc err_;
+};
+
+inline constexpr std::size_t frame_header_size = 8;
+
+namespace detail {
+
+inline void put_u32le ( std::byte* ptr, std::uint32_t val ) noexcept {
+  for (int k = 0; k < 4; k++) ptr[k] = static_cast<std::byte> (val >> (k * 8));
+}
+
+inline std::uint32_t get_u32le ( const std::byte* ptr ) noexcept {
+  std::uint32_t val = 0;
+  for (int k = 0; k < 4; k++) val |= static_cast<std::uint32_t> (ptr[k]) << (k * 8);
+  return val;
+}
+
+inline void check ( int res_val ) {
+  if (res_val != LZ32_SUCCESS) throw stream_error (detail::to_errc (res_val));
+}
+
+/* appends to 'buf' within the capacity reserved up front */
+
+inline std::span<const std::byte> append ( buffer& buf, std::size_t lim, std::span<const std::byte> src ) {
+  std::size_t len = std::min (lim - buf.size (), src.size ());
+  std::memcpy ( buf.data () + buf.size (), src.data (), len );
+  buf.resize (buf.size () + len);
+  return src.subspan (len);
+}
+
+class chain_encoder {
+public:
+  chain_encoder ( int cmr_lvl, std::size_t chunk_size, std::pmr::memory_resource* mr ) : out_ (mr) {
+    out_.reserve (frame_header_size + compress_bound (chunk_size));
+    lz32_alloc alc = resource_allocator (mr);
+    int res = lz32_cchain_init ( &(cc_), &(alc), cmr_lvl, chunk_size );
+    if (res != LZ32_SUCCESS) throw stream_error ((res == LZ32_EUNKNOWN) ? errc::memory : detail::to_errc (res));
+  }
+
+  chain_encoder ( const chain_encoder& ) = delete;
+  chain_encoder& operator= ( const chain_encoder& ) = delete;
+
+  ~chain_encoder () { lz32_cchain_free (&(cc_)); }
+
+  /* one frame for all of 'src' (at most chunk_size), valid until the next call */
+
+  std::span<const std::byte> encode ( std::span<const std::byte> src ) {
+    std::size_t slen = src.size (), dlen = compress_bound (src.size ());
+    out_.resize (frame_header_size + dlen);
+    check (lz32_cchain_compress ( &(cc_), src.data (), &(slen), out_.data () + frame_header_size, &(dlen) ));
+    put_u32le ( out_.data (), static_cast<std::uint32_t> (slen) );
+    put_u32le ( out_.data () + 4, static_cast<std::uint32_t> (dlen) );
+    out_.resize (frame_header_size + dlen);
+    return out_.span ();
+  }
+
+private:
+  lz32_cchain cc_;
+  buffer out_;
+};
+
+class chain_decoder {
+public:
+  chain_decoder ( std::size_t chunk_size, std::pmr::memory_resource* mr ) : chunk_size_ (chunk_size) {
+    lz32_alloc alc = resource_allocator (mr);
+    int res = lz32_dchain_init ( &(dc_), &(alc), chunk_size );
+    if (res != LZ32_SUCCESS) throw stream_error ((res == LZ32_EUNKNOWN) ? errc::memory : detail::to_errc (res));
+  }
+
+  chain_decoder ( const chain_decoder& ) = delete;
+  chain_decoder& operator= ( const chain_decoder& ) = delete;
+
+  ~chain_decoder () { lz32_dchain_free (&(dc_)); }
+
+  /* block size of a frame from its header, after checking both sizes */
+
+  std::size_t block_size ( const std::byte* hdr ) const {
+    std::size_t raw_len = get_u32le (hdr), blk_len = get_u32le (hdr + 4);
+    if ((raw_len < LZ32_RAW_SIZE_MIN) || (raw_len > chunk_size_)) throw stream_error (errc::data);
+    if ((blk_len < LZ32_BLK_SIZE_MIN) || (blk_len > compress_bound (raw_len)) || ((blk_len & 15) != 0)) throw stream_error (errc::data);
+    return blk_len;
+  }
+
+  /* decodes a whole frame whose block is 4-byte aligned; the bytes stay valid until the next call */
+
+  std::span<const std::byte> decode ( const std::byte* frm ) {
+    const void* out = nullptr;
+    std::size_t raw_len = get_u32le (frm), blk_len = get_u32le (frm + 4);
+    check (lz32_dchain_decompress ( &(dc_), frm + frame_header_size, blk_len, raw_len, &(out) ));
+    return { static_cast<const std::byte*> (out), raw_len };
+  }
+
+private:
+  lz32_dchain dc_;
+  std::size_t chunk_size_;
+};
+
+}
+
+
+/* yields one frame per chunk_size bytes of input (or per piece with flush_each) */
+
+template <int Level> requires valid_level<Level>
+async_generator<std::span<const std::byte>> compress_stream ( async_generator<std::span<const std::byte>> input, 
+                                                              stream_options opt = {} ) {
+  detail::chain_encoder enc (Level, opt.chunk_size, opt.resource);
+
+  buffer pend (opt.resource);
+  pend.reserve (opt.chunk_size);
+
+  while (const std::span<const std::byte>* piece = co_await input.next ()) {
+    std::span<const std::byte> src = *piece;
+
+    while (!src.empty ()) {
+
+      /* whole chunks straight from the piece when nothing is pending */
+
+      if ((pend.size () == 0) && (src.size () >= opt.chunk_size)) {
+        co_yield enc.encode (src.first (opt.chunk_size));
+        src = src.subspan (opt.chunk_size);
+        continue;
+      }
+
+      src = detail::append (pend, opt.chunk_size, src);
+      if (pend.size () == opt.chunk_size) {
+        co_yield enc.encode (pend.span ());
+        pend.clear ();
+      }
+    }
+
+    if (opt.flush_each && pend.size () != 0) {
+      co_yield enc.encode (pend.span ());
+      pend.clear ();
+    }
+  }
+
+  if (pend.size () != 0) co_yield enc.encode (pend.span ());
+}
+
+
+/* yields the raw bytes of each frame; a frame cut short at the end is errc::data */
+
+inline async_generator<std::span<const std::byte>> decompress_stream ( async_generator<std::span<const std::byte>> input, 
+                                                                       stream_options opt = {} ) {
+  detail::chain_decoder dec (opt.chunk_size, opt.resource);
+
+  buffer frm (opt.resource);
+  frm.reserve (frame_header_size + compress_bound (opt.chunk_size));
+  std::size_t need = frame_header_size;
+
+  while (const std::span<const std::byte>* piece = co_await input.next ()) {
+    std::span<const std::byte> src = *piece;
+
+    while (!src.empty ()) {
+
+      /* a whole, aligned frame in the piece decodes in place */
+
+      if ( (frm.size () == 0) && (src.size () >= frame_header_size) && 
+           ((reinterpret_cast<std::uintptr_t> (src.data ()) & 3) == 0) ) {
+        std::size_t frm_len = frame_header_size + dec.block_size (src.data ());
+        if (src.size () >= frm_len) {
+          co_yield dec.decode (src.data ());
+          src = src.subspan (frm_len);
+          continue;
+        }
+      }
+
+      src = detail::append (frm, need, src);
+      if (frm.size () < need) break;
+
+      if (need == frame_header_size) {
+        need += dec.block_size (frm.data ());
+        continue;
+      }
+
+      co_yield dec.decode (frm.data ());
+      frm.clear ();
+      need = frame_header_size;
+    }
+  }
+
+  if (frm.size () != 0) throw stream_error (errc::data);
+}
+
+
+#endif /* LZ32_HPP_COROUTINES */
+
+
+}
+
+#endif /* LZ32_HPP */
@@ -0,0 +1,398 @@
+
+/* ---------- LZ32 hot kernel micro-benchmarks ---------- */
+
+/*
+ * Build : cc -O2 -o lz32bench lz32bench.c
+ * Usage : lz32bench [-k kernel] [-l LO:HI] [-m LO:HI] [-o LO:HI] [-n calls] [-s seed]
+ *
+ *   -k  kernel name (default: all) : hash40, common, match255, htbins, litcopy, mtccopy
+ *   -l  literal length range        (default 0:64)
+ *   -m  match length range          (default 5:64)
+ *   -o  match offset range          (default 1:15, at most 65535)
+ *   -n  calls per kernel            (default 16777216)
+ *   -s  random seed                 (default 1)
+ *
+ * The kernels are 'static inline' in lz32.c, so the library source is included
+ * directly and every kernel is measured in the same form as in the codec loops.
+ */
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <time.h>
+
+#include "lz32.c"
+
+
+/* ----------  ---------- */
+
+
+#define LZ32B_SAMPLES 4096
+#define LZ32B_SLOT 512
+#define LZ32B_OFF_MAX 65535
+#define LZ32B_MTC_BUF ((size_t)64 << 20)
+
+
+typedef struct lz32b_range { size_t lo, hi; } lz32b_range;
+
+typedef struct lz32b_conf {
+  lz32b_range lit, mtc, off;
+  size_t calls;
+  u64t seed;
+} lz32b_conf;
+
+
+/* ----------  ---------- */
+
+
+static u64t lz32b_rng_state = 1;
+
+static u64t lz32b_rand ( void ) {
+  u64t x = lz32b_rng_state;
+  x ^= x << 13; x ^= x >> 7; x ^= x << 17;
+  lz32b_rng_state = x;
+  return x;
+}
+
+static size_t lz32b_pick ( lz32b_range rng ) {
+  if (rng.hi <= rng.lo) return rng.lo;
+  return rng.lo + (size_t)(lz32b_rand () % (rng.hi - rng.lo + 1));
+}
+
+static double lz32b_now_ns ( void ) {
+  struct timespec ts;
+  clock_gettime ( CLOCK_MONOTONIC, &(ts) );
+  return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+static volatile u64t lz32b_sink;
+
+static void lz32b_report ( const char* name, double ns, size_t calls, size_t bytes ) {
+  double ns_call = ns / (double)calls;
+  double mb_sec = ((double)bytes / (1024.0 * 1024.0)) / (ns / 1e9);
+  printf ( "%-10s %10.3f ns/call %10.1f MB/s %12zu calls\n", name, ns_call, mb_sec, calls );
+}
+
+
+/* ---------- hash_40 ---------- */
+
+
+static void lz32b_hash40 ( const lz32b_conf* cnf ) {
+
+  u64t seq_buf[LZ32B_SAMPLES];
+  for (size_t i = 0; i < LZ32B_SAMPLES; i++) seq_buf[i] = lz32b_rand ();
+
+  u64t acc = 0;
+  size_t cnt = 0;
+  double beg = lz32b_now_ns ();
+
+  while (cnt < cnf->calls) {
+    for (size_t i = 0; i < LZ32B_SAMPLES; i++) {
+      acc += hash_40 ( seq_buf[i] ^ acc, LZ32_HTB_LOG_FAST );
+    }
+    cnt += LZ32B_SAMPLES;
+  }
+
+  double end = lz32b_now_ns ();
+  lz32b_sink = acc;
+  lz32b_report ( "hash40", end - beg, cnt, cnt * 8 );
+}
+
+
+/* ---------- lz32_count_common_bytes ---------- */
+
+
+static void lz32b_common ( const lz32b_conf* cnf ) {
+
+  u64t dif_buf[LZ32B_SAMPLES];
+  for (size_t i = 0; i < LZ32B_SAMPLES; i++) {
+    size_t sft = (lz32b_pick (cnf->mtc) & 7) * 8;
+    dif_buf[i] = (lz32b_rand () | 1) << sft;
+  }
+
+  u64t acc = 0;
+  size_t cnt = 0;
+  double beg = lz32b_now_ns ();
+
+  while (cnt < cnf->calls) {
+    for (size_t i = 0; i < LZ32B_SAMPLES; i++) {
+      acc += lz32_count_common_bytes (dif_buf[i]);
+    }
+    cnt += LZ32B_SAMPLES;
+  }
+
+  double end = lz32b_now_ns ();
+  lz32b_sink = acc;
+  lz32b_report ( "common", end - beg, cnt, cnt * 8 );
+}
+
+
+/* ---------- lz32_count_match_255 ---------- */
+
+
+static void lz32b_match255 ( const lz32b_conf* cnf ) {
+
+  size_t buf_len = (size_t)LZ32B_SAMPLES * LZ32B_SLOT * 2;
+  char* buf = (char*)malloc (buf_len);
+  size_t* len_buf = (size_t*)malloc (LZ32B_SAMPLES * sizeof (size_t));
+  if ((buf == NULL) || (len_buf == NULL)) { free (buf); free (len_buf); return; }
+
+  for (size_t i = 0; i < buf_len; i++) buf[i] = (char)lz32b_rand ();
+
+  size_t tot = 0;
+  for (size_t i = 0; i < LZ32B_SAMPLES; i++) {
+    char* mptr = buf + (i * 2 * LZ32B_SLOT);
+    char* cptr = mptr + LZ32B_SLOT;
+    size_t mlen = lz32b_pick (cnf->mtc);
+    if (mlen > 255) mlen = 255;
+    memcpy ( cptr, mptr, mlen );
+    cptr[mlen] = (char)(mptr[mlen] ^ 0x5A);
+    len_buf[i] = mlen;
+    tot += mlen;
+  }
+
+  u64t acc = 0;
+  size_t cnt = 0, bytes = 0;
+  double beg = lz32b_now_ns ();
+
+  while (cnt < cnf->calls) {
+    for (size_t i = 0; i < LZ32B_SAMPLES; i++) {
+      const char* mptr = buf + (i * 2 * LZ32B_SLOT);
+      const char* cptr = mptr + LZ32B_SLOT;
+      acc += lz32_count_match_255 ( mptr, cptr, (cptr + LZ32B_SLOT) );
+    }
+    cnt += LZ32B_SAMPLES;
+    bytes += tot;
+  }
+
+  double end = lz32b_now_ns ();
+  lz32b_sink = acc;
+  lz32b_report ( "match255", end - beg, cnt, bytes );
+
+  free (len_buf);
+  free (buf);
+}
+
+
+/* ---------- lz32_htb_insert_fast ---------- */
+
+
+static void lz32b_htbins ( const lz32b_conf* cnf ) {
+
+  size_t buf_len = (size_t)LZ32B_SAMPLES * LZ32B_SLOT;
+  char* buf = (char*)malloc (buf_len + 16);
+  size_t* cnt_buf = (size_t*)malloc (LZ32B_SAMPLES * sizeof (size_t));
+  u32t* htb_ptr = (u32t*)malloc ((size_t)4 << LZ32_HTB_LOG_FAST);
+  if ((buf == NULL) || (cnt_buf == NULL) || (htb_ptr == NULL)) {
+    free (buf); free (cnt_buf); free (htb_ptr); return;
+  }
+
+  for (size_t i = 0; i < buf_len + 16; i++) buf[i] = (char)lz32b_rand ();
+  lz32_setbits1 ( htb_ptr, (size_t)4 << LZ32_HTB_LOG_FAST );
+
+  size_t tot = 0;
+  for (size_t i = 0; i < LZ32B_SAMPLES; i++) {
+    size_t mlen = lz32b_pick (cnf->mtc);
+    if (mlen > 255) mlen = 255;
+    if (mlen < 1) mlen = 1;
+    cnt_buf[i] = mlen - 1;
+    tot += mlen - 1;
+  }
+
+  size_t cnt = 0, bytes = 0;
+  double beg = lz32b_now_ns ();
+
+  while (cnt < cnf->calls) {
+    for (size_t i = 0; i < LZ32B_SAMPLES; i++) {
+      size_t pos = i * LZ32B_SLOT;
+      lz32_htb_insert_fast ( htb_ptr, (buf + pos), pos, cnt_buf[i], LZ32_HTB_LOG_FAST );
+    }
+    cnt += LZ32B_SAMPLES;
+    bytes += tot;
+  }
+
+  double end = lz32b_now_ns ();
+  lz32b_sink = htb_ptr[lz32b_rand () & (((size_t)1 << LZ32_HTB_LOG_FAST) - 1)];
+  lz32b_report ( "htbins", end - beg, cnt, bytes );
+
+  free (htb_ptr);
+  free (cnt_buf);
+  free (buf);
+}
+
+
+/* ---------- lz32_copy_literals ---------- */
+
+
+static void lz32b_litcopy ( const lz32b_conf* cnf ) {
+
+  size_t buf_len = (size_t)LZ32B_SAMPLES * LZ32B_SLOT;
+  char* src = (char*)malloc (buf_len);
+  char* dst = (char*)malloc (buf_len);
+  size_t* len_buf = (size_t*)malloc (LZ32B_SAMPLES * sizeof (size_t));
+  if ((src == NULL) || (dst == NULL) || (len_buf == NULL)) {
+    free (src); free (dst); free (len_buf); return;
+  }
+
+  for (size_t i = 0; i < buf_len; i++) src[i] = (char)lz32b_rand ();
+
+  size_t tot = 0;
+  for (size_t i = 0; i < LZ32B_SAMPLES; i++) {
+    size_t llen = lz32b_pick (cnf->lit);
+    if (llen > 255) llen = 255;
+    len_buf[i] = llen;
+    tot += llen;
+  }
+
+  size_t cnt = 0, bytes = 0;
+  double beg = lz32b_now_ns ();
+
+  while (cnt < cnf->calls) {
+    for (size_t i = 0; i < LZ32B_SAMPLES; i++) {
+      size_t pos = i * LZ32B_SLOT;
+      lz32_copy_literals ( (dst + pos), (src + pos), len_buf[i] );
+    }
+    cnt += LZ32B_SAMPLES;
+    bytes += tot;
+  }
+
+  double end = lz32b_now_ns ();
+  lz32b_sink = (u64t)dst[lz32b_rand () % buf_len];
+  lz32b_report ( "litcopy", end - beg, cnt, bytes );
+
+  free (len_buf);
+  free (dst);
+  free (src);
+}
+
+
+/* ---------- lz32_copy_match ---------- */
+
+
+static void lz32b_mtccopy ( const lz32b_conf* cnf ) {
+
+  /* every sample gets its own slot : the largest offset before the copy point, */
+  /* room for a 255-byte match and the wild copy overrun behind it              */
+  size_t off_max = (cnf->off.hi < 1) ? 1 : cnf->off.hi;
+  size_t slot = (off_max + (LZ32B_SLOT / 2) + 63) & ~(size_t)63;
+  size_t smp_cnt = LZ32B_SAMPLES;
+  if (smp_cnt * slot > LZ32B_MTC_BUF) smp_cnt = LZ32B_MTC_BUF / slot;
+
+  size_t buf_len = smp_cnt * slot;
+  char* buf = (char*)malloc (buf_len);
+  size_t* len_buf = (size_t*)malloc (smp_cnt * sizeof (size_t));
+  size_t* off_buf = (size_t*)malloc (smp_cnt * sizeof (size_t));
+  if ((buf == NULL) || (len_buf == NULL) || (off_buf == NULL)) {
+    free (buf); free (len_buf); free (off_buf); return;
+  }
+
+  for (size_t i = 0; i < buf_len; i++) buf[i] = (char)lz32b_rand ();
+
+  size_t tot = 0;
+  for (size_t i = 0; i < smp_cnt; i++) {
+    size_t mlen = lz32b_pick (cnf->mtc);
+    size_t moff = lz32b_pick (cnf->off);
+    if (mlen > 255) mlen = 255;
+    if (moff < 1) moff = 1;
+    len_buf[i] = mlen;
+    off_buf[i] = moff;
+    tot += mlen;
+  }
+
+  size_t cnt = 0, bytes = 0;
+  double beg = lz32b_now_ns ();
+
+  while (cnt < cnf->calls) {
+    for (size_t i = 0; i < smp_cnt; i++) {
+      char* out_cur = buf + (i * slot) + off_max;
+      lz32_copy_match ( out_cur, off_buf[i], len_buf[i] );
+    }
+    cnt += smp_cnt;
+    bytes += tot;
+  }
+
+  double end = lz32b_now_ns ();
+  lz32b_sink = (u64t)buf[lz32b_rand () % buf_len];
+  lz32b_report ( "mtccopy", end - beg, cnt, bytes );
+
+  free (off_buf);
+  free (len_buf);
+  free (buf);
+}
+
+
+/* ----------  ---------- */
+
+
+static int lz32b_parse_range ( const char* arg, lz32b_range* rng ) {
+  char* end = NULL;
+  unsigned long lo = strtoul (arg, &(end), 10);
+  unsigned long hi = lo;
+  if (end == arg) return 1;
+  if (*(end) == ':') {
+    const char* nxt = end + 1;
+    hi = strtoul (nxt, &(end), 10);
+    if (end == nxt) return 1;
+  }
+  if ((*(end) != '\0') || (hi < lo)) return 1;
+  rng->lo = lo; rng->hi = hi;
+  return 0;
+}
+
+
+int main ( int argc, char** argv ) {
+
+  static const struct { const char* name; void (*func) ( const lz32b_conf* ); } kernels[] = {
+    { "hash40",   lz32b_hash40   },
+    { "common",   lz32b_common   },
+    { "match255", lz32b_match255 },
+    { "htbins",   lz32b_htbins   },
+    { "litcopy",  lz32b_litcopy  },
+    { "mtccopy",  lz32b_mtccopy  },
+  };
+  const size_t kernel_cnt = sizeof (kernels) / sizeof (kernels[0]);
+
+  lz32b_conf cnf = { { 0, 64 }, { 5, 64 }, { 1, 15 }, (size_t)1 << 24, 1 };
+  const char* sel = NULL;
+
+  for (int i = 1; i < argc; i++) {
+    const char* opt = argv[i];
+    const char* arg = (i + 1 < argc) ? argv[i + 1] : NULL;
+    int bad = (arg == NULL);
+    if (bad == 0) {
+      if      (strcmp (opt, "-k") == 0) sel = arg;
+      else if (strcmp (opt, "-l") == 0) bad = lz32b_parse_range (arg, &(cnf.lit));
+      else if (strcmp (opt, "-m") == 0) bad = lz32b_parse_range (arg, &(cnf.mtc));
+      else if (strcmp (opt, "-o") == 0) bad = lz32b_parse_range (arg, &(cnf.off)) || (cnf.off.hi > LZ32B_OFF_MAX);
+      else if (strcmp (opt, "-n") == 0) cnf.calls = strtoull (arg, NULL, 10);
+      else if (strcmp (opt, "-s") == 0) cnf.seed = strtoull (arg, NULL, 10);
+      else bad = 1;
+    }
+    if (bad != 0) {
+      fprintf ( stderr, "usage: %s [-k kernel] [-l LO:HI] [-m LO:HI] [-o LO:HI] [-n calls] [-s seed]\n", argv[0] );
+      fprintf ( stderr, "       match offsets (-o) are at most %d\n", LZ32B_OFF_MAX );
+      return EXIT_FAILURE;
+    }
+    i++;
+  }
+
+  if (cnf.calls == 0) cnf.calls = LZ32B_SAMPLES;
+
+  printf ( "lit %zu:%zu  mtc %zu:%zu  off %zu:%zu  calls %zu\n",
+           cnf.lit.lo, cnf.lit.hi, cnf.mtc.lo, cnf.mtc.hi, cnf.off.lo, cnf.off.hi, cnf.calls );
+
+  int found = 0;
+  for (size_t k = 0; k < kernel_cnt; k++) {
+    if ((sel != NULL) && (strcmp (sel, kernels[k].name) != 0)) continue;
+    lz32b_rng_state = (cnf.seed != 0) ? cnf.seed : 1;
+    kernels[k].func (&(cnf));
+    found = 1;
+  }
+
+  if (found == 0) {
+    fprintf ( stderr, "%s: unknown kernel '%s'\n", argv[0], sel );
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+
@@ -0,0 +1,641 @@
+
+/* ---------- LZ32 deduplicating front-end ---------- */
+
+/*
+ * Build : cc -O2 -o lz32dedup lz32dedup.c
+ * Usage : lz32dedup [-f | -h] -c in out     split, deduplicate and compress ('-' reads stdin)
+ *         lz32dedup -d in out               restore; 'out' must be a regular file
+ *
+ * The input is cut into content-defined chunks (2 KB min, 8 KB average, 64 KB max) by a
+ * gear hash, so an insertion only moves the cut points around it. Each chunk is looked
+ * up by a 128-bit fingerprint (two seeded XXH64s) plus its length; a chunk seen before
+ * becomes a reference to its ID, new chunks are gathered into segments of up to 1 MB
+ * and compressed as one lz32 block, so the 64 KB window still spans chunk boundaries.
+ * The decoder keeps the output offset of every chunk and copies references back out of
+ * the file it is writing.
+ *
+ *   header  [ magic:8 | version:4 | 0:4 ]
+ *   new     [ 1:4 | chunks:4 | raw size:4 | block size:4 ]
+ *           [ chunk sizes:4 each | raw checksum:4 ], padded to 16, then the lz32 block
+ *   ref     [ 2:4 | first ID:4 | count:4 | 0:4 ]       consecutive IDs in one record
+ *   end     [ 3:4 | chunks:4 | raw size:8 ]
+ *
+ * Chunk IDs count new chunks from 0 in stream order. The raw checksum is the low 32
+ * bits of the XXH64 of the segment.
+ */
+
+#define _FILE_OFFSET_BITS 64
+#define _GNU_SOURCE
+
+#include "lz32.c"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+
+
+/* ---------- Format ---------- */
+
+
+#define LZ32U_MAGIC 0x5055444432335A4CULL             /* "LZ32DDUP" */
+#define LZ32U_VERSION 1
+
+#define LZ32U_REC_NEW 1
+#define LZ32U_REC_REF 2
+#define LZ32U_REC_END 3
+
+#define LZ32U_CHUNK_MIN 2048
+#define LZ32U_CHUNK_AVG 8192
+#define LZ32U_CHUNK_MAX 65536
+
+#define LZ32U_SEG_MAX (1 << 20)
+#define LZ32U_SEG_CHUNKS ((LZ32U_SEG_MAX + LZ32U_CHUNK_MAX) / LZ32U_CHUNK_MIN)
+
+#define LZ32U_INP_LEN (8 << 20)
+
+/* normalized chunking: a stricter cut condition before the average size, a looser one after */
+
+#define LZ32U_MASK_S 0xFFFE000000000000ULL            /* 15 bits */
+#define LZ32U_MASK_L 0xFFE0000000000000ULL            /* 11 bits */
+
+typedef struct lz32u_result {
+  unsigned long long raw_bytes, out_bytes;
+  unsigned long long uniq_bytes;
+  unsigned long long chunks, uniq_chunks;
+} lz32u_result;
+
+
+/* ---------- Chunking ---------- */
+
+
+static u64t lz32u_gear[256];
+
+static void lz32u_gear_init ( void ) {
+  u64t seq = 0x4C5A3332ULL;
+  for (size_t k = 0; k < 256; k++) {
+    u64t val = (seq += 0x9E3779B97F4A7C15ULL);
+    val = (val ^ (val >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    val = (val ^ (val >> 27)) * 0x94D049BB133111EBULL;
+    lz32u_gear[k] = val ^ (val >> 31);
+  }
+}
+
+
+/*
+ * Length of the chunk starting at 'src', given 'len' bytes are available (fewer than
+ * LZ32U_CHUNK_MAX only at the end of the input). The hash of a position only depends
+ * on the 64 bytes before it, so hashing starts 64 bytes short of the minimum size.
+ */
+
+static size_t lz32u_cut ( const u8t* src, size_t len ) {
+
+  if (len <= LZ32U_CHUNK_MIN) return len;
+  if (len > LZ32U_CHUNK_MAX) len = LZ32U_CHUNK_MAX;
+
+  size_t mid = (len < LZ32U_CHUNK_AVG) ? len : LZ32U_CHUNK_AVG;
+  size_t pos = LZ32U_CHUNK_MIN - 64;
+  u64t hsh = 0;
+
+  for (; pos < LZ32U_CHUNK_MIN; pos++) hsh = (hsh << 1) + lz32u_gear[src[pos]];
+
+  for (; pos < mid; pos++) {
+    hsh = (hsh << 1) + lz32u_gear[src[pos]];
+    if ((hsh & LZ32U_MASK_S) == 0) return pos + 1;
+  }
+
+  for (; pos < len; pos++) {
+    hsh = (hsh << 1) + lz32u_gear[src[pos]];
+    if ((hsh & LZ32U_MASK_L) == 0) return pos + 1;
+  }
+
+  return len;
+}
+
+
+/* ---------- Fingerprint index ---------- */
+
+
+typedef struct lz32u_slot {
+  u64t fp0, fp1;
+  u32t len;
+  u32t idp;                     /* chunk ID + 1, zero is empty */
+} lz32u_slot;
+
+typedef struct lz32u_index {
+  lz32u_slot* slot_ptr;
+  size_t slot_msk, slot_cnt;
+} lz32u_index;
+
+
+static int lz32u_index_grow ( lz32u_index* idx ) {
+
+  size_t cap = (idx->slot_ptr != NULL) ? (2 * (idx->slot_msk + 1)) : 65536;
+  lz32u_slot* ptr = (lz32u_slot*)calloc ( cap, sizeof (lz32u_slot) );
+  if (ptr == NULL) return LZ32_EUNKNOWN;
+
+  for (size_t k = 0; (idx->slot_ptr != NULL) && (k <= idx->slot_msk); k++) {
+    const lz32u_slot* cur = idx->slot_ptr + k;
+    if (cur->idp == 0) continue;
+    size_t pos = (size_t)cur->fp0 & (cap - 1);
+    while (ptr[pos].idp != 0) pos = (pos + 1) & (cap - 1);
+    ptr[pos] = *(cur);
+  }
+
+  free (idx->slot_ptr);
+  idx->slot_ptr = ptr;
+  idx->slot_msk = cap - 1;
+  return LZ32_SUCCESS;
+}
+
+
+/* Returns the ID of an equal chunk, or inserts 'id' and returns it */
+
+static int lz32u_index_find ( lz32u_index* idx, const void* src, size_t len, u32t id, u32t* out_id ) {
+
+  if ((idx->slot_cnt * 2) >= idx->slot_msk) {
+    if (lz32u_index_grow (idx) != LZ32_SUCCESS) return LZ32_EUNKNOWN;
+  }
+
+  u64t fp0 = xxh64_hash_seed ( src, len, 0 );
+  u64t fp1 = xxh64_hash_seed ( src, len, 0x4C5A33324444ULL );
+  size_t pos = (size_t)fp0 & idx->slot_msk;
+
+  while (idx->slot_ptr[pos].idp != 0) {
+    const lz32u_slot* cur = idx->slot_ptr + pos;
+    if ((cur->fp0 == fp0) && (cur->fp1 == fp1) && (cur->len == (u32t)len)) {
+      *(out_id) = cur->idp - 1;
+      return LZ32_SUCCESS;
+    }
+    pos = (pos + 1) & idx->slot_msk;
+  }
+
+  lz32u_slot* cur = idx->slot_ptr + pos;
+  cur->fp0 = fp0; cur->fp1 = fp1;
+  cur->len = (u32t)len;
+  cur->idp = id + 1;
+  idx->slot_cnt += 1;
+
+  *(out_id) = id;
+  return LZ32_SUCCESS;
+}
+
+
+/* ---------- Writer ---------- */
+
+
+typedef struct lz32u_writer {
+  FILE* fp;
+  int cmr_lvl;
+  lz32u_index idx;
+  u32t next_id;
+  u32t ref_first, ref_cnt;
+  char* seg_buf;
+  size_t seg_len;
+  u32t seg_chk[LZ32U_SEG_CHUNKS];
+  size_t seg_cnt;
+  char* blk_buf;
+  size_t blk_cap;
+  lz32u_result* res;
+} lz32u_writer;
+
+
+static int lz32u_put ( lz32u_writer* wr, const void* ptr, size_t len ) {
+  if ((len != 0) && (fwrite ( ptr, 1, len, wr->fp ) != len)) return LZ32_EUNKNOWN;
+  wr->res->out_bytes += len;
+  return LZ32_SUCCESS;
+}
+
+
+static int lz32u_flush_refs ( lz32u_writer* wr ) {
+
+  if (wr->ref_cnt == 0) return LZ32_SUCCESS;
+
+  char rec[16];
+  memset ( rec, 0, sizeof (rec) );
+  lz32_write32 ( (rec + 0), LZ32U_REC_REF );
+  lz32_write32 ( (rec + 4), wr->ref_first );
+  lz32_write32 ( (rec + 8), wr->ref_cnt );
+
+  wr->ref_cnt = 0;
+  return lz32u_put ( wr, rec, sizeof (rec) );
+}
+
+
+static int lz32u_flush_segment ( lz32u_writer* wr ) {
+
+  if (wr->seg_cnt == 0) return LZ32_SUCCESS;
+
+  size_t slen = wr->seg_len, dlen = 0;
+  int res = lz32_compress_bound ( &(slen), &(dlen) );
+  if (res != LZ32_SUCCESS) return res;
+
+  if (wr->blk_cap < dlen) {
+    free (wr->blk_buf);
+    wr->blk_buf = (char*)malloc (dlen);
+    wr->blk_cap = (wr->blk_buf != NULL) ? dlen : 0;
+    if (wr->blk_buf == NULL) return LZ32_EUNKNOWN;
+  }
+
+  if (wr->cmr_lvl >= LZ32_LEVEL_HIGH) res = lz32_compress_high ( wr->seg_buf, &(slen), wr->blk_buf, &(dlen) );
+  else                                res = lz32_compress_fast ( wr->seg_buf, &(slen), wr->blk_buf, &(dlen) );
+  if (res != LZ32_SUCCESS) return res;
+  if (slen != wr->seg_len) return LZ32_EUNKNOWN;
+
+/* -----  ----- */
+
+  char rec[16];
+  lz32_write32 ( (rec + 0), LZ32U_REC_NEW );
+  lz32_write32 ( (rec + 4), (u32t)wr->seg_cnt );
+  lz32_write32 ( (rec + 8), (u32t)wr->seg_len );
+  lz32_write32 ( (rec + 12), (u32t)dlen );
+
+  /* chunk sizes are already in file order and endianness */
+
+  char tail[20];
+  size_t tlen = lz32_ceil16 (4 * wr->seg_cnt + 4) - 4 * wr->seg_cnt;
+  memset ( tail, 0, sizeof (tail) );
+  lz32_write32 ( tail, xxh64_hash_low32 ( wr->seg_buf, wr->seg_len ) );
+
+  res = lz32u_put ( wr, rec, sizeof (rec) );
+  if (res == LZ32_SUCCESS) res = lz32u_put ( wr, wr->seg_chk, 4 * wr->seg_cnt );
+  if (res == LZ32_SUCCESS) res = lz32u_put ( wr, tail, tlen );
+  if (res == LZ32_SUCCESS) res = lz32u_put ( wr, wr->blk_buf, dlen );
+
+  wr->seg_len = 0;
+  wr->seg_cnt = 0;
+  return res;
+}
+
+
+static int lz32u_add_chunk ( lz32u_writer* wr, const char* src, size_t len ) {
+
+  u32t cid = 0;
+  int res = lz32u_index_find ( &(wr->idx), src, len, wr->next_id, &(cid) );
+  if (res != LZ32_SUCCESS) return res;
+
+  wr->res->chunks += 1;
+
+/* -----  ----- */
+
+  if (cid != wr->next_id) {
+
+    if ((wr->ref_cnt != 0) && (cid == wr->ref_first + wr->ref_cnt)) {
+      wr->ref_cnt += 1;
+      return LZ32_SUCCESS;
+    }
+
+    res = lz32u_flush_segment (wr);
+    if (res == LZ32_SUCCESS) res = lz32u_flush_refs (wr);
+
+    wr->ref_first = cid;
+    wr->ref_cnt = 1;
+    return res;
+  }
+
+/* -----  ----- */
+
+  if (wr->next_id == 0xFFFFFFFFu) return LZ32_EINVAL;
+
+  res = lz32u_flush_refs (wr);
+  if ((res == LZ32_SUCCESS) && ((wr->seg_len + len) > LZ32U_SEG_MAX)) res = lz32u_flush_segment (wr);
+  if (res != LZ32_SUCCESS) return res;
+
+  memcpy ( (wr->seg_buf + wr->seg_len), src, len );
+  wr->seg_len += len;
+  lz32_write32 ( (wr->seg_chk + wr->seg_cnt), (u32t)len );
+  wr->seg_cnt += 1;
+
+  wr->next_id += 1;
+  wr->res->uniq_chunks += 1;
+  wr->res->uniq_bytes += len;
+
+  return LZ32_SUCCESS;
+}
+
+
+/* Compresses all of 'inp' into 'out', which is left open */
+
+int lz32u_compress_file ( FILE* inp, FILE* out, int cmr_lvl, lz32u_result* res ) {
+
+  if ((inp == NULL) || (out == NULL) || (res == NULL)) return LZ32_EINVAL;
+  memset ( res, 0, sizeof (*res) );
+
+  lz32u_writer* wr = (lz32u_writer*)calloc ( 1, sizeof (lz32u_writer) );
+  char* inp_buf = (char*)malloc (LZ32U_INP_LEN);
+  if (wr != NULL) wr->seg_buf = (char*)malloc (LZ32U_SEG_MAX);
+
+  int err = ((wr == NULL) || (inp_buf == NULL) || (wr->seg_buf == NULL)) ? LZ32_EUNKNOWN : LZ32_SUCCESS;
+
+  if (err == LZ32_SUCCESS) {
+    wr->fp = out;
+    wr->cmr_lvl = cmr_lvl;
+    wr->res = res;
+    if (lz32u_gear[0] == 0) lz32u_gear_init ();
+
+    char head[16];
+    memset ( head, 0, sizeof (head) );
+    lz32_write64 ( (head + 0), LZ32U_MAGIC );
+    lz32_write32 ( (head + 8), LZ32U_VERSION );
+    err = lz32u_put ( wr, head, sizeof (head) );
+  }
+
+/* -----  ----- */
+
+  /* keep at least one maximum chunk ahead of the cut unless the input has ended */
+
+  size_t inp_len = 0, inp_pos = 0;
+  int eof = 0;
+
+  while (err == LZ32_SUCCESS) {
+
+    if ((eof == 0) && ((inp_len - inp_pos) < LZ32U_CHUNK_MAX)) {
+      memmove ( inp_buf, (inp_buf + inp_pos), (inp_len - inp_pos) );
+      inp_len -= inp_pos; inp_pos = 0;
+      size_t got = fread ( (inp_buf + inp_len), 1, (LZ32U_INP_LEN - inp_len), inp );
+      if (got == 0) {
+        if (ferror (inp)) { err = LZ32_EUNKNOWN; break; }
+        eof = 1;
+      }
+      inp_len += got;
+      res->raw_bytes += got;
+      continue;
+    }
+
+    if (inp_pos == inp_len) break;
+
+    size_t len = lz32u_cut ( (const u8t*)(inp_buf + inp_pos), (inp_len - inp_pos) );
+    err = lz32u_add_chunk ( wr, (inp_buf + inp_pos), len );
+    inp_pos += len;
+  }
+
+/* -----  ----- */
+
+  if (err == LZ32_SUCCESS) err = lz32u_flush_segment (wr);
+  if (err == LZ32_SUCCESS) err = lz32u_flush_refs (wr);
+
+  if (err == LZ32_SUCCESS) {
+    char rec[16];
+    lz32_write32 ( (rec + 0), LZ32U_REC_END );
+    lz32_write32 ( (rec + 4), (u32t)res->chunks );
+    lz32_write64 ( (rec + 8), (u64t)res->raw_bytes );
+    err = lz32u_put ( wr, rec, sizeof (rec) );
+  }
+
+  if ((err == LZ32_SUCCESS) && (fflush (out) != 0)) err = LZ32_EUNKNOWN;
+
+  if (wr != NULL) {
+    free (wr->idx.slot_ptr);
+    free (wr->blk_buf);
+    free (wr->seg_buf);
+    free (wr);
+  }
+  free (inp_buf);
+
+  return err;
+}
+
+
+/* ---------- Reader ---------- */
+
+
+typedef struct lz32u_chunk {
+  u64t out_off;
+  u32t len;
+} lz32u_chunk;
+
+
+static int lz32u_read_exact ( FILE* fp, void* ptr, size_t len, lz32u_result* res ) {
+  if ((len != 0) && (fread ( ptr, 1, len, fp ) != len)) return LZ32_EDATA;
+  res->raw_bytes += len;
+  return LZ32_SUCCESS;
+}
+
+
+static int lz32u_write_at ( int fd, const char* ptr, size_t len, u64t off ) {
+  while (len != 0) {
+    ssize_t cnt = pwrite ( fd, ptr, len, (off_t)off );
+    if ((cnt < 0) && (errno == EINTR)) continue;
+    if (cnt <= 0) return LZ32_EUNKNOWN;
+    ptr += cnt; len -= (size_t)cnt; off += (u64t)cnt;
+  }
+  return LZ32_SUCCESS;
+}
+
+
+static int lz32u_read_at ( int fd, char* ptr, size_t len, u64t off ) {
+  while (len != 0) {
+    ssize_t cnt = pread ( fd, ptr, len, (off_t)off );
+    if ((cnt < 0) && (errno == EINTR)) continue;
+    if (cnt <= 0) return LZ32_EUNKNOWN;
+    ptr += cnt; len -= (size_t)cnt; off += (u64t)cnt;
+  }
+  return LZ32_SUCCESS;
+}
+
+
+/*
+ * Restores a stream into 'out_fd', which must be readable, writable and seekable.
+ * In 'res' the byte counts are swapped round: raw_bytes is what was read, out_bytes
+ * what was restored.
+ */
+
+int lz32u_decompress_file ( FILE* inp, int out_fd, lz32u_result* res ) {
+
+  if ((inp == NULL) || (out_fd < 0) || (res == NULL)) return LZ32_EINVAL;
+  memset ( res, 0, sizeof (*res) );
+
+  size_t blk_max = LZ32U_SEG_MAX, blk_cap = 0;
+  lz32_compress_bound ( &(blk_max), &(blk_cap) );
+
+  char* seg_buf = (char*)malloc (LZ32U_SEG_MAX);
+  char* blk_buf = (char*)malloc (blk_cap);
+  u32t* len_buf = (u32t*)malloc (4 * LZ32U_SEG_CHUNKS + 16);
+  lz32u_chunk* chk_ptr = NULL;
+  size_t chk_cnt = 0, chk_cap = 0;
+  u64t out_pos = 0;
+
+  int err = ((seg_buf == NULL) || (blk_buf == NULL) || (len_buf == NULL)) ? LZ32_EUNKNOWN : LZ32_SUCCESS;
+
+  char rec[16];
+  if (err == LZ32_SUCCESS) err = lz32u_read_exact ( inp, rec, sizeof (rec), res );
+  if ((err == LZ32_SUCCESS) && ((lz32_read64 (rec) != LZ32U_MAGIC) || (lz32_read32 (rec + 8) != LZ32U_VERSION))) err = LZ32_EDATA;
+
+/* -----  ----- */
+
+  while (err == LZ32_SUCCESS) {
+
+    err = lz32u_read_exact ( inp, rec, sizeof (rec), res );
+    if (err != LZ32_SUCCESS) break;
+
+    u32t tag = lz32_read32 (rec + 0);
+    u32t arg1 = lz32_read32 (rec + 4);
+    u32t arg2 = lz32_read32 (rec + 8);
+    u32t arg3 = lz32_read32 (rec + 12);
+
+    if (tag == LZ32U_REC_END) {
+      u64t raw_len = lz32_read64 (rec + 8);
+      if ((raw_len != out_pos) || (arg1 != (u32t)res->chunks)) err = LZ32_EDATA;
+      break;
+    }
+
+    if (tag == LZ32U_REC_NEW) {
+
+      if ((arg1 == 0) || (arg1 > LZ32U_SEG_CHUNKS) || (arg2 > LZ32U_SEG_MAX) || (arg3 > blk_cap)) { err = LZ32_EDATA; break; }
+      if ((chk_cnt + arg1) > 0xFFFFFFFFu) { err = LZ32_EDATA; break; }
+
+      size_t lens_len = lz32_ceil16 (4 * (size_t)arg1 + 4);
+      err = lz32u_read_exact ( inp, len_buf, lens_len, res );
+      if (err == LZ32_SUCCESS) err = lz32u_read_exact ( inp, blk_buf, arg3, res );
+      if (err != LZ32_SUCCESS) break;
+
+      if ((chk_cnt + arg1) > chk_cap) {
+        size_t cap = (chk_cap != 0) ? (2 * chk_cap) : 65536;
+        while (cap < (chk_cnt + arg1)) cap *= 2;
+        lz32u_chunk* ptr = (lz32u_chunk*)realloc ( chk_ptr, cap * sizeof (lz32u_chunk) );
+        if (ptr == NULL) { err = LZ32_EUNKNOWN; break; }
+        chk_ptr = ptr; chk_cap = cap;
+      }
+
+      u64t sum = 0;
+      for (size_t k = 0; k < arg1; k++) {
+        u32t len = lz32_read32 (len_buf + k);
+        if ((len == 0) || (len > LZ32U_CHUNK_MAX)) sum = (u64t)arg2 + 1;
+        chk_ptr[chk_cnt + k].out_off = out_pos + sum;
+        chk_ptr[chk_cnt + k].len = len;
+        sum += len;
+      }
+      if (sum != arg2) { err = LZ32_EDATA; break; }
+
+      err = lz32_decompress_safe ( blk_buf, arg3, seg_buf, arg2 );
+      if ((err == LZ32_SUCCESS) && (xxh64_hash_low32 ( seg_buf, arg2 ) != lz32_read32 (len_buf + arg1))) err = LZ32_EDATA;
+      if (err == LZ32_SUCCESS) err = lz32u_write_at ( out_fd, seg_buf, arg2, out_pos );
+      if (err != LZ32_SUCCESS) break;
+
+      chk_cnt += arg1;
+      out_pos += arg2;
+      res->chunks += arg1;
+      res->uniq_chunks += arg1;
+      res->uniq_bytes += arg2;
+      continue;
+    }
+
+/* -----  ----- */
+
+    if (tag == LZ32U_REC_REF) {
+
+      if ((arg2 == 0) || (arg1 >= chk_cnt) || (arg2 > (chk_cnt - arg1))) { err = LZ32_EDATA; break; }
+
+      /* runs of chunks that were adjacent when first written are copied in one go */
+
+      for (size_t k = arg1; (err == LZ32_SUCCESS) && (k < (size_t)arg1 + arg2); ) {
+        u64t src_off = chk_ptr[k].out_off;
+        size_t len = chk_ptr[k].len;
+        k += 1;
+        while ( (k < (size_t)arg1 + arg2) && ((len + chk_ptr[k].len) <= LZ32U_SEG_MAX) &&
+                (chk_ptr[k].out_off == src_off + len) ) {
+          len += chk_ptr[k].len; k += 1;
+        }
+        err = lz32u_read_at ( out_fd, seg_buf, len, src_off );
+        if (err == LZ32_SUCCESS) err = lz32u_write_at ( out_fd, seg_buf, len, out_pos );
+        out_pos += len;
+      }
+
+      res->chunks += arg2;
+      continue;
+    }
+
+    err = LZ32_EDATA;
+  }
+
+/* -----  ----- */
+
+  res->out_bytes = out_pos;
+
+  if ((err == LZ32_SUCCESS) && (ftruncate ( out_fd, (off_t)out_pos ) != 0)) err = LZ32_EUNKNOWN;
+
+  free (chk_ptr);
+  free (len_buf);
+  free (blk_buf);
+  free (seg_buf);
+
+  return err;
+}
+
+
+/* ---------- Command line ---------- */
+
+
+static double lz32u_now ( void ) {
+  struct timespec ts;
+  clock_gettime ( CLOCK_MONOTONIC, &(ts) );
+  return (double)ts.tv_sec + 1e-9 * (double)ts.tv_nsec;
+}
+
+
+int main ( int argc, char** argv ) {
+
+  int level = LZ32_LEVEL_FAST, argi = 1;
+  if ((argi < argc) && (strcmp (argv[argi], "-f") == 0)) { level = LZ32_LEVEL_FAST; argi += 1; }
+  else if ((argi < argc) && (strcmp (argv[argi], "-h") == 0)) { level = LZ32_LEVEL_HIGH; argi += 1; }
+
+  const char* cmd = (argi < argc) ? argv[argi] : "";
+
+  if ((argi + 3 != argc) || ((strcmp (cmd, "-c") != 0) && (strcmp (cmd, "-d") != 0))) {
+    fprintf ( stderr, "usage: %s [-f | -h] -c in out\n"
+                      "       %s -d in out\n", argv[0], argv[0] );
+    return EXIT_FAILURE;
+  }
+
+  const char* inp_path = argv[argi + 1];
+  const char* out_path = argv[argi + 2];
+
+  FILE* inp = (strcmp (inp_path, "-") == 0) ? stdin : fopen ( inp_path, "rb" );
+  if (inp == NULL) { fprintf ( stderr, "lz32dedup: cannot open '%s'\n", inp_path ); return EXIT_FAILURE; }
+
+  lz32u_result res;
+  double t0 = lz32u_now ();
+  int err = LZ32_EUNKNOWN;
+
+/* -----  ----- */
+
+  if (strcmp (cmd, "-c") == 0) {
+
+    FILE* out = fopen ( out_path, "wb" );
+    if (out == NULL) { fprintf ( stderr, "lz32dedup: cannot open '%s'\n", out_path ); return EXIT_FAILURE; }
+
+    err = lz32u_compress_file ( inp, out, level, &(res) );
+    if (fclose (out) != 0) err = LZ32_EUNKNOWN;
+
+  } else {
+
+    int fd = open ( out_path, O_RDWR | O_CREAT | O_TRUNC, 0644 );
+    if (fd < 0) { fprintf ( stderr, "lz32dedup: cannot open '%s'\n", out_path ); return EXIT_FAILURE; }
+
+    err = lz32u_decompress_file ( inp, fd, &(res) );
+    if (close (fd) != 0) err = LZ32_EUNKNOWN;
+  }
+
+  if (inp != stdin) fclose (inp);
+
+/* -----  ----- */
+
+  if (err != LZ32_SUCCESS) {
+    fprintf ( stderr, "lz32dedup: %s failed: %s\n", (cmd[1] == 'c') ? "compression" : "restore", lz32_error_string (err) );
+    return EXIT_FAILURE;
+  }
+
+  double sec = lz32u_now () - t0;
+  unsigned long long big = (cmd[1] == 'c') ? res.raw_bytes : res.out_bytes;
+
+  fprintf ( stderr, "%llu -> %llu bytes (ratio %.3f), %llu of %llu chunks unique (%.1f%% of bytes), %.1f MB/s\n",
+            res.raw_bytes, res.out_bytes,
+            (res.raw_bytes != 0) ? ((cmd[1] == 'c') ? ((double)res.raw_bytes / (double)res.out_bytes)
+                                                    : ((double)res.out_bytes / (double)res.raw_bytes)) : 0.0,
+            res.uniq_chunks, res.chunks,
+            (big != 0) ? (100.0 * (double)res.uniq_bytes / (double)big) : 0.0,
+            (sec > 0) ? ((double)big / sec / 1e6) : 0.0 );
+
+  return EXIT_SUCCESS;
+}
+
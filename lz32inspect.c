@@ -0,0 +1,291 @@
+
+/* ---------- LZ32 block inspector ---------- */
+
+/*
+ * Build : cc -O2 -o lz32inspect lz32inspect.c
+ * Usage : lz32inspect [-f | -h] [-d] [-r raw_len] file
+ *
+ *   (none)  'file' holds one lz32 block as produced by lz32_compress_fast/high
+ *   -f, -h  'file' holds raw data, compressed here block by block at fast/high level
+ *   -d      dump every sequence (literal length, match length, offset, positions)
+ *   -r      raw size of the block, splits the tail into raw literals and padding
+ *
+ * Sequences are decoded with lz32_decode_token(), the same routine the decoder uses,
+ * and every token is bounds-checked so damaged blocks are reported instead of walked.
+ */
+
+#include "lz32.c"
+
+
+/* ----------  ---------- */
+
+
+typedef struct lz32i_summary {
+  size_t blocks;
+  size_t raw_bytes, blk_bytes;
+  size_t tokens, fillers;
+  size_t lit_bytes, mtc_bytes;
+  size_t tail_bytes, pad_bytes;
+  size_t tkn_bytes, end_bytes;
+  size_t lit_hist[LZ32_STATS_BUCKETS];
+  size_t mtc_hist[LZ32_STATS_BUCKETS];
+  size_t off_hist[LZ32_STATS_BUCKETS];
+  size_t mtc_cover[LZ32_STATS_BUCKETS];
+} lz32i_summary;
+
+
+/* ----------  ---------- */
+
+
+static size_t lz32i_bucket ( size_t val ) {
+  size_t idx = 0;
+  while ((val != 0) && (idx < (LZ32_STATS_BUCKETS - 1))) {
+    val >>= 1; idx += 1;
+  }
+  return idx;
+}
+
+
+/* ---------- Token stream walk ---------- */
+
+
+static int lz32i_walk ( const char* blk_ptr, size_t blk_len, size_t raw_len, int dump, lz32i_summary* sum ) {
+
+  if ((blk_len < LZ32_BLK_SIZE_MIN) || ((blk_len & 15) != 0)) {
+    fprintf ( stderr, "lz32inspect: block size %zu is not a multiple of 16\n", blk_len );
+    return 1;
+  }
+
+  const char* inp_lit = blk_ptr;
+  const char* inp_tkn = blk_ptr + blk_len;
+  size_t out_pos = 0, seq_idx = 0;
+  size_t lit_len, mtc_len, mtc_off;
+  u32t cur_tkn;
+
+  inp_tkn -= 4;
+  cur_tkn = lz32_read32 (inp_tkn);
+
+  while (cur_tkn != 0) {
+
+    lz32_decode_token ( cur_tkn, &(lit_len), &(mtc_len), &(mtc_off) );
+
+    if ((mtc_off == 0) ? (mtc_len != 0) : (mtc_len < 5)) {
+      fprintf ( stderr, "lz32inspect: sequence %zu: invalid token 0x%08X\n", seq_idx, (unsigned)cur_tkn );
+      return 1;
+    }
+    if ((size_t)(inp_tkn - inp_lit) < (lit_len + 4)) {
+      fprintf ( stderr, "lz32inspect: sequence %zu: literals overlap the token stream\n", seq_idx );
+      return 1;
+    }
+    if (mtc_off > (out_pos + lit_len)) {
+      fprintf ( stderr, "lz32inspect: sequence %zu: offset %zu points before the block\n", seq_idx, mtc_off );
+      return 1;
+    }
+
+    if (dump != 0) {
+      printf ( "%8zu  lit %3zu  mtc %3zu  off %5zu  at out %10zu  lit %10zu  tkn %10zu\n",
+               seq_idx, lit_len, mtc_len, mtc_off, out_pos,
+               (size_t)(inp_lit - blk_ptr), (size_t)(inp_tkn - blk_ptr) );
+    }
+
+    sum->tokens += 1;
+    sum->lit_bytes += lit_len;
+    sum->mtc_bytes += mtc_len;
+
+    if (mtc_len == 0) {
+      sum->fillers += 1;
+    } else {
+      sum->lit_hist[lz32i_bucket (lit_len)] += 1;
+      sum->mtc_hist[lz32i_bucket (mtc_len)] += 1;
+      sum->off_hist[lz32i_bucket (mtc_off)] += 1;
+      sum->mtc_cover[lz32i_bucket (mtc_len)] += mtc_len;
+    }
+
+    inp_lit += lit_len;
+    out_pos += lit_len + mtc_len;
+    seq_idx += 1;
+
+    inp_tkn -= 4;
+    cur_tkn = lz32_read32 (inp_tkn);
+  }
+
+  size_t gap_len = (size_t)(inp_tkn - inp_lit);
+  size_t tail_len = gap_len;
+
+  if (raw_len != 0) {
+    if ((raw_len < out_pos) || ((raw_len - out_pos) > gap_len)) {
+      fprintf ( stderr, "lz32inspect: raw size %zu does not fit the token stream\n", raw_len );
+      return 1;
+    }
+    tail_len = raw_len - out_pos;
+  }
+
+  sum->blocks += 1;
+  sum->raw_bytes += out_pos + tail_len;
+  sum->blk_bytes += blk_len;
+  sum->tail_bytes += tail_len;
+  sum->pad_bytes += gap_len - tail_len;
+  sum->tkn_bytes += (size_t)(blk_ptr + blk_len - inp_tkn) - 4;
+  sum->end_bytes += 4;
+
+  return 0;
+}
+
+
+/* ---------- Report ---------- */
+
+
+static double lz32i_pct ( size_t part, size_t whole ) {
+  return (whole != 0) ? (100.0 * (double)part / (double)whole) : 0.0;
+}
+
+
+static void lz32i_hist ( const char* name, const size_t* hist ) {
+
+  size_t tot = 0;
+  for (size_t k = 0; k < LZ32_STATS_BUCKETS; k++) tot += hist[k];
+  if (tot == 0) return;
+
+  printf ( "\n%s\n", name );
+  for (size_t k = 0; k < LZ32_STATS_BUCKETS; k++) {
+    if (hist[k] == 0) continue;
+    size_t lo = (k == 0) ? 0 : ((size_t)1 << (k - 1));
+    size_t hi = (k == 0) ? 0 : (((size_t)1 << k) - 1);
+    printf ( "  %6zu .. %-6zu %12zu  %6.2f%%\n", lo, hi, hist[k], lz32i_pct (hist[k], tot) );
+  }
+}
+
+
+static void lz32i_report ( const lz32i_summary* sum ) {
+
+  size_t seqs = sum->tokens - sum->fillers;
+  size_t blk = sum->blk_bytes;
+
+  printf ( "blocks          %12zu\n", sum->blocks );
+  printf ( "raw bytes       %12zu\n", sum->raw_bytes );
+  printf ( "block bytes     %12zu  (ratio %.3f)\n", blk,
+           (blk != 0) ? ((double)sum->raw_bytes / (double)blk) : 0.0 );
+  printf ( "sequences       %12zu\n", seqs );
+  printf ( "filler tokens   %12zu\n", sum->fillers );
+  printf ( "matched bytes   %12zu  %6.2f%% of raw\n", sum->mtc_bytes, lz32i_pct (sum->mtc_bytes, sum->raw_bytes) );
+
+  printf ( "\nblock bytes spent on\n" );
+  printf ( "  literals      %12zu  %6.2f%%\n", sum->lit_bytes, lz32i_pct (sum->lit_bytes, blk) );
+  printf ( "  tail literals %12zu  %6.2f%%\n", sum->tail_bytes, lz32i_pct (sum->tail_bytes, blk) );
+  printf ( "  tokens        %12zu  %6.2f%%\n", sum->tkn_bytes - (4 * sum->fillers), lz32i_pct (sum->tkn_bytes - (4 * sum->fillers), blk) );
+  printf ( "  filler tokens %12zu  %6.2f%%\n", 4 * sum->fillers, lz32i_pct (4 * sum->fillers, blk) );
+  printf ( "  terminators   %12zu  %6.2f%%\n", sum->end_bytes, lz32i_pct (sum->end_bytes, blk) );
+  printf ( "  padding       %12zu  %6.2f%%\n", sum->pad_bytes, lz32i_pct (sum->pad_bytes, blk) );
+
+  lz32i_hist ( "literal run length", sum->lit_hist );
+  lz32i_hist ( "match length", sum->mtc_hist );
+  lz32i_hist ( "match offset", sum->off_hist );
+
+  if (seqs != 0) {
+    printf ( "\nnet bytes saved by match length (covered - 4 per token)\n" );
+    for (size_t k = 0; k < LZ32_STATS_BUCKETS; k++) {
+      if (sum->mtc_hist[k] == 0) continue;
+      size_t lo = (size_t)1 << (k - 1), hi = ((size_t)1 << k) - 1;
+      size_t cost = 4 * sum->mtc_hist[k];
+      printf ( "  %6zu .. %-6zu %12zu  (%.2f bytes per token)\n", lo, hi,
+               sum->mtc_cover[k] - cost, (double)(sum->mtc_cover[k] - cost) / (double)sum->mtc_hist[k] );
+    }
+  }
+}
+
+
+/* ----------  ---------- */
+
+
+static char* lz32i_load ( const char* path, size_t* len ) {
+
+  FILE* fp = fopen (path, "rb");
+  if (fp == NULL) return NULL;
+
+  char* buf = NULL;
+  long flen = -1;
+  if (fseek (fp, 0, SEEK_END) == 0) flen = ftell (fp);
+  if ((flen >= 0) && (fseek (fp, 0, SEEK_SET) == 0)) {
+    buf = (char*)malloc (lz32_ceil16 ((size_t)flen + 16));
+    if ((buf != NULL) && (fread (buf, 1, (size_t)flen, fp) != (size_t)flen)) {
+      free (buf); buf = NULL;
+    }
+  }
+
+  fclose (fp);
+  *(len) = (size_t)flen;
+  return buf;
+}
+
+
+int main ( int argc, char** argv ) {
+
+  int level = 0, dump = 0;
+  size_t raw_len = 0;
+  const char* path = NULL;
+
+  for (int i = 1; i < argc; i++) {
+    if      (strcmp (argv[i], "-f") == 0) level = 1;
+    else if (strcmp (argv[i], "-h") == 0) level = 9;
+    else if (strcmp (argv[i], "-d") == 0) dump = 1;
+    else if ((strcmp (argv[i], "-r") == 0) && (i + 1 < argc)) raw_len = strtoull (argv[++i], NULL, 10);
+    else if ((argv[i][0] != '-') && (path == NULL)) path = argv[i];
+    else { path = NULL; break; }
+  }
+
+  if (path == NULL) {
+    fprintf ( stderr, "usage: %s [-f | -h] [-d] [-r raw_len] file\n", argv[0] );
+    return EXIT_FAILURE;
+  }
+
+  size_t len = 0;
+  char* buf = lz32i_load (path, &(len));
+  if (buf == NULL) {
+    fprintf ( stderr, "lz32inspect: cannot read '%s'\n", path );
+    return EXIT_FAILURE;
+  }
+
+  lz32i_summary sum;
+  memset ( &(sum), 0, sizeof (sum) );
+  int res = 0;
+
+  if (level == 0) {
+
+    res = lz32i_walk ( buf, len, raw_len, dump, &(sum) );
+
+  } else {
+
+    size_t pos = 0;
+    char* blk = NULL;
+
+    while ((res == 0) && (pos < len)) {
+
+      size_t slen = len - pos, dlen = 0;
+      size_t blen = slen;
+      lz32_compress_bound ( &(blen), &(dlen) );
+
+      free (blk);
+      blk = (char*)malloc (dlen);
+      if (blk == NULL) { res = 1; break; }
+
+      slen = blen;
+      if (level == 1) res = lz32_compress_fast ( (buf + pos), &(slen), blk, &(dlen) );
+      else            res = lz32_compress_high ( (buf + pos), &(slen), blk, &(dlen) );
+      if (res != LZ32_SUCCESS) {
+        fprintf ( stderr, "lz32inspect: compression failed: %s\n", lz32_error_string (res) );
+        break;
+      }
+
+      res = lz32i_walk ( blk, dlen, slen, dump, &(sum) );
+      pos += slen;
+    }
+
+    free (blk);
+  }
+
+  if (res == 0) lz32i_report (&(sum));
+
+  free (buf);
+  return (res == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
@@ -0,0 +1,615 @@
+
+/* ---------- LZ32 pack file ---------- */
+
+/*
+ * Build : cc -O2 -o lz32pack lz32pack.c
+ * Usage : lz32pack [-f | -h] -a pack file...     add files, keyed by the path as given
+ *         lz32pack -g pack key                   write one object to stdout
+ *         lz32pack -l pack                       list keys and sizes
+ *         lz32pack -t pack                       time a get of every key, in random order
+ *
+ * Many small objects in one file: an append-only data region of lz32 blocks, then an
+ * index sorted by the XXH64 of the key, a fence of the first hash of every index page
+ * and a footer. Readers mmap the file; a lookup searches the fence (a few KB that stay
+ * cached), then one index page, compares the key stored just in front of the block and
+ * decodes the block straight from the mapping.
+ *
+ *   header  [ magic:8 | version:4 | 0:4 ]
+ *   data    [ key, padded to 16 | lz32 block ] ...
+ *   index   lz32k_entry[cnt], page aligned
+ *   fence   u64t[ceil(cnt / LZ32K_PAGE_ENTRIES)]
+ *   footer  [ magic:8 | cnt:8 | index offset:8 | data end:8 ]
+ *
+ * Adding to an existing pack never rewrites it: the new objects, index, fence and footer
+ * go after the old footer, and the old index turns into dead bytes of the data region.
+ * A crash during an append leaves the old footer as the last complete one; the reader
+ * scans back to it and the next writer cuts off whatever follows. A key added again
+ * replaces the older object, whose bytes stay in the data region until the pack is
+ * rewritten.
+ */
+
+#define _FILE_OFFSET_BITS 64
+#define _GNU_SOURCE
+
+#include "lz32.c"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+
+/* ---------- Format ---------- */
+
+
+#define LZ32K_MAGIC 0x4B43415032335A4CULL             /* "LZ32PACK" */
+#define LZ32K_VERSION 1
+
+#define LZ32K_PAGE 4096
+#define LZ32K_PAGE_ENTRIES (LZ32K_PAGE / sizeof (lz32k_entry))
+
+#define LZ32K_HEAD_LEN 16
+#define LZ32K_FOOT_LEN 32
+
+#define LZ32K_KEY_MAX 4096
+
+#define LZ32K_ENOKEY 3
+
+typedef struct lz32k_entry {
+  u64t key_hash;
+  u64t blk_off;
+  u32t blk_len;
+  u32t raw_len;
+  u32t key_len;
+  u32t raw_chk;                 /* low 32 bits of the XXH64 of the object */
+} lz32k_entry;
+
+
+/* ----------  ---------- */
+
+
+static size_t lz32k_lower_bound ( const char* ptr, size_t stride, size_t lo, size_t hi, u64t key_hash ) {
+  while (lo < hi) {
+    size_t mid = lo + ((hi - lo) >> 1);
+    if (lz32_read64 (ptr + mid * stride) < key_hash) lo = mid + 1;
+    else hi = mid;
+  }
+  return lo;
+}
+
+
+/* ---------- Reader ---------- */
+
+
+typedef struct lz32k_pack {
+  const char* map_ptr;
+  size_t map_len;
+  size_t pack_len;
+  u64t data_end;
+  size_t ent_cnt;
+  const lz32k_entry* ent_ptr;
+  const u64t* fence_ptr;
+  size_t fence_cnt;
+} lz32k_pack;
+
+
+/* Checks the footer ending at 'end' against the layout in front of it, returns 0 if it doesn't fit */
+
+static int lz32k_check_foot ( const char* map, size_t end, u64t* cnt, u64t* idx_off, u64t* data_end ) {
+
+  const char* foot = map + end - LZ32K_FOOT_LEN;
+  if (lz32_read64 (foot) != LZ32K_MAGIC) return 0;
+
+  *(cnt) = lz32_read64 (foot + 8);
+  *(idx_off) = lz32_read64 (foot + 16);
+  *(data_end) = lz32_read64 (foot + 24);
+
+  /* bound every field before it enters a sum, so that no product or sum can wrap */
+
+  size_t idx_end = end - LZ32K_FOOT_LEN;
+  if ((*(idx_off) > idx_end) || ((*(idx_off) % LZ32K_PAGE) != 0)) return 0;
+  if ((*(data_end) < LZ32K_HEAD_LEN) || (*(data_end) > *(idx_off))) return 0;
+  if (*(cnt) > ((idx_end - *(idx_off)) / sizeof (lz32k_entry))) return 0;
+
+  u64t fence_cnt = (*(cnt) + LZ32K_PAGE_ENTRIES - 1) / LZ32K_PAGE_ENTRIES;
+  return ((*(idx_off) + *(cnt) * sizeof (lz32k_entry) + fence_cnt * 8) == idx_end);
+}
+
+
+lz32k_pack* lz32k_open ( const char* path ) {
+
+  int fd = open ( path, O_RDONLY | O_CLOEXEC );
+  if (fd < 0) return NULL;
+
+  struct stat st;
+  lz32k_pack* pk = NULL;
+  char* map = MAP_FAILED;
+
+  if ((fstat ( fd, &(st) ) == 0) && ((u64t)st.st_size >= (LZ32K_HEAD_LEN + LZ32K_FOOT_LEN))) {
+    map = (char*)mmap ( NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0 );
+  }
+  close (fd);
+  if (map == MAP_FAILED) return NULL;
+
+/* -----  ----- */
+
+  /* a footer ends on a multiple of 8; past the last complete one there is only an unfinished append */
+
+  size_t len = (size_t)st.st_size;
+  size_t end = len & ~(size_t)7;
+  u64t cnt = 0, idx_off = 0, data_end = 0;
+
+  int ok = (lz32_read64 (map) == LZ32K_MAGIC) && (lz32_read32 (map + 8) == LZ32K_VERSION);
+  while (ok && (lz32k_check_foot ( map, end, &(cnt), &(idx_off), &(data_end) ) == 0)) {
+    end -= 8;
+    ok = (end >= (LZ32K_HEAD_LEN + LZ32K_FOOT_LEN));
+  }
+
+  if (ok) pk = (lz32k_pack*)calloc ( 1, sizeof (lz32k_pack) );
+  if (pk == NULL) { munmap ( map, len ); errno = EINVAL; return NULL; }
+
+  u64t fence_cnt = (cnt + LZ32K_PAGE_ENTRIES - 1) / LZ32K_PAGE_ENTRIES;
+
+  pk->map_ptr = map;
+  pk->map_len = len;
+  pk->pack_len = end;
+  pk->data_end = data_end;
+  pk->ent_cnt = (size_t)cnt;
+  pk->ent_ptr = (const lz32k_entry*)(map + idx_off);
+  pk->fence_ptr = (const u64t*)(map + idx_off + cnt * sizeof (lz32k_entry));
+  pk->fence_cnt = (size_t)fence_cnt;
+
+  /* lookups are random: no readahead around the touched pages, but keep the fence resident */
+
+  madvise ( map, len, MADV_RANDOM );
+  size_t fence_pg = (size_t)(idx_off + cnt * sizeof (lz32k_entry)) & ~((size_t)LZ32K_PAGE - 1);
+  madvise ( (map + fence_pg), (end - fence_pg), MADV_WILLNEED );
+
+  return pk;
+}
+
+
+void lz32k_close ( lz32k_pack* pk ) {
+  if (pk == NULL) return;
+  munmap ( (void*)pk->map_ptr, pk->map_len );
+  free (pk);
+}
+
+
+/* Returns the index entry of 'key', pointing into the mapping, or NULL */
+
+const lz32k_entry* lz32k_find ( const lz32k_pack* pk, const void* key_ptr, size_t key_len ) {
+
+  if (pk->ent_cnt == 0) return NULL;
+  u64t key_hash = xxh64_hash ( key_ptr, key_len );
+
+  /* the first entry not below 'key_hash' is in the page before the first fence not below it, or opens that page */
+
+  size_t pg = lz32k_lower_bound ( (const char*)pk->fence_ptr, 8, 0, pk->fence_cnt, key_hash );
+  size_t lo = (pg != 0) ? ((pg - 1) * LZ32K_PAGE_ENTRIES) : 0;
+  size_t hi = pg * LZ32K_PAGE_ENTRIES + 1;
+  if (hi > pk->ent_cnt) hi = pk->ent_cnt;
+
+  size_t idx = lz32k_lower_bound ( (const char*)pk->ent_ptr, sizeof (lz32k_entry), lo, hi, key_hash );
+
+/* -----  ----- */
+
+  for (; (idx < pk->ent_cnt) && (pk->ent_ptr[idx].key_hash == key_hash); idx++) {
+
+    const lz32k_entry* ent = pk->ent_ptr + idx;
+    u64t key_pad = lz32_ceil16 (ent->key_len);
+
+    if ( (ent->key_len != key_len) || (ent->blk_off > pk->data_end) || (ent->blk_off < (LZ32K_HEAD_LEN + key_pad)) ||
+         (ent->blk_len > (pk->data_end - ent->blk_off)) ) continue;
+
+    if (memcmp ( (pk->map_ptr + ent->blk_off - key_pad), key_ptr, key_len ) == 0) return ent;
+  }
+
+  return NULL;
+}
+
+
+/* 'dst_len' holds the capacity on entry and the object size on return */
+
+int lz32k_get ( const lz32k_pack* pk, const void* key_ptr, size_t key_len, void* dst_ptr, size_t* dst_len ) {
+
+  if ((pk == NULL) || (key_ptr == NULL) || (dst_ptr == NULL) || (dst_len == NULL)) return LZ32_EINVAL;
+  size_t dcap = *(dst_len);
+  *(dst_len) = 0;
+
+  const lz32k_entry* ent = lz32k_find ( pk, key_ptr, key_len );
+  if (ent == NULL) return LZ32K_ENOKEY;
+  if (ent->raw_len > dcap) return LZ32_EINVAL;
+  if (ent->raw_len == 0) return LZ32_SUCCESS;
+
+  int res = lz32_decompress_safe ( (pk->map_ptr + ent->blk_off), ent->blk_len, dst_ptr, ent->raw_len );
+  if (res != LZ32_SUCCESS) return res;
+  if (xxh64_hash_low32 ( dst_ptr, ent->raw_len ) != ent->raw_chk) return LZ32_EDATA;
+
+  *(dst_len) = ent->raw_len;
+  return LZ32_SUCCESS;
+}
+
+
+/* ---------- Writer ---------- */
+
+
+typedef struct lz32k_wentry {
+  lz32k_entry ent;
+  size_t key_pos;
+  size_t seq;
+} lz32k_wentry;
+
+typedef struct lz32k_writer {
+  FILE* fp;
+  int cmr_lvl;
+  u64t data_end;
+  lz32k_wentry* ent_ptr;
+  size_t ent_cnt, ent_cap;
+  char* key_buf;
+  size_t key_len, key_cap;
+  char* blk_buf;
+  size_t blk_cap;
+} lz32k_writer;
+
+
+static int lz32k_writer_push ( lz32k_writer* wr, const lz32k_entry* ent, const void* key_ptr ) {
+
+  if (wr->ent_cnt == wr->ent_cap) {
+    size_t cap = (wr->ent_cap != 0) ? (2 * wr->ent_cap) : 1024;
+    lz32k_wentry* ptr = (lz32k_wentry*)realloc ( wr->ent_ptr, cap * sizeof (lz32k_wentry) );
+    if (ptr == NULL) return LZ32_EUNKNOWN;
+    wr->ent_ptr = ptr; wr->ent_cap = cap;
+  }
+
+  if ((wr->key_cap - wr->key_len) < ent->key_len) {
+    size_t cap = (wr->key_cap != 0) ? (2 * wr->key_cap) : 65536;
+    while ((cap - wr->key_len) < ent->key_len) cap *= 2;
+    char* ptr = (char*)realloc ( wr->key_buf, cap );
+    if (ptr == NULL) return LZ32_EUNKNOWN;
+    wr->key_buf = ptr; wr->key_cap = cap;
+  }
+
+  lz32k_wentry* went = wr->ent_ptr + wr->ent_cnt;
+  went->ent = *(ent);
+  went->key_pos = wr->key_len;
+  went->seq = wr->ent_cnt;
+  memcpy ( (wr->key_buf + wr->key_len), key_ptr, ent->key_len );
+
+  wr->key_len += ent->key_len;
+  wr->ent_cnt += 1;
+  return LZ32_SUCCESS;
+}
+
+
+/* Opens 'path' for adding; an existing pack keeps its objects and its index until close */
+
+lz32k_writer* lz32k_writer_open ( const char* path, int cmr_lvl ) {
+
+  lz32k_writer* wr = (lz32k_writer*)calloc ( 1, sizeof (lz32k_writer) );
+  if (wr == NULL) return NULL;
+  wr->cmr_lvl = cmr_lvl;
+
+  lz32k_pack* pk = NULL;
+  struct stat st;
+
+  if (stat ( path, &(st) ) == 0) {
+    pk = lz32k_open (path);
+    if (pk == NULL) { free (wr); errno = EINVAL; return NULL; }
+  }
+
+/* -----  ----- */
+
+  if (pk != NULL) {
+
+    for (size_t k = 0; k < pk->ent_cnt; k++) {
+      const lz32k_entry* ent = pk->ent_ptr + k;
+      u64t key_pad = lz32_ceil16 (ent->key_len);
+      int bad = (ent->blk_off < (LZ32K_HEAD_LEN + key_pad)) || (ent->blk_off > pk->data_end);
+      if (bad || (lz32k_writer_push ( wr, ent, (pk->map_ptr + ent->blk_off - key_pad) ) != LZ32_SUCCESS)) {
+        lz32k_close (pk); free (wr->ent_ptr); free (wr->key_buf); free (wr);
+        return NULL;
+      }
+    }
+
+    /* only the rest of an unfinished append is cut off, the pack itself stays readable throughout */
+
+    static const char pad_buf[16];
+    size_t pack_len = pk->pack_len, map_len = pk->map_len;
+    size_t pad_len = lz32_ceil16 (pack_len) - pack_len;
+    lz32k_close (pk);
+
+    wr->data_end = pack_len + pad_len;
+
+    if ((pack_len == map_len) || (truncate ( path, (off_t)pack_len ) == 0)) wr->fp = fopen ( path, "r+b" );
+    if ( (wr->fp != NULL) && ( (fseeko ( wr->fp, (off_t)pack_len, SEEK_SET ) != 0) ||
+                               (fwrite ( pad_buf, 1, pad_len, wr->fp ) != pad_len) ) ) { fclose (wr->fp); wr->fp = NULL; }
+
+  } else {
+
+    char head[LZ32K_HEAD_LEN];
+    memset ( head, 0, sizeof (head) );
+    lz32_write64 ( (head + 0), LZ32K_MAGIC );
+    lz32_write32 ( (head + 8), LZ32K_VERSION );
+
+    wr->fp = fopen ( path, "w+b" );
+    if ((wr->fp != NULL) && (fwrite ( head, 1, sizeof (head), wr->fp ) != sizeof (head))) { fclose (wr->fp); wr->fp = NULL; }
+    wr->data_end = LZ32K_HEAD_LEN;
+  }
+
+  if (wr->fp == NULL) {
+    free (wr->ent_ptr); free (wr->key_buf); free (wr);
+    return NULL;
+  }
+
+  return wr;
+}
+
+
+int lz32k_writer_add ( lz32k_writer* wr, const void* key_ptr, size_t key_len, const void* src_ptr, size_t src_len ) {
+
+  if ((wr == NULL) || (key_ptr == NULL) || (src_ptr == NULL)) return LZ32_EINVAL;
+  if ((key_len > LZ32K_KEY_MAX) || (src_len > LZ32_RAW_SIZE_MAX)) return LZ32_EINVAL;
+
+/* -----  ----- */
+
+  /* empty objects get an entry and no block */
+
+  size_t slen = src_len, dlen = 0;
+  int res = LZ32_SUCCESS;
+
+  if (src_len != 0) {
+
+    res = lz32_compress_bound ( &(slen), &(dlen) );
+    if (res != LZ32_SUCCESS) return res;
+
+    if (wr->blk_cap < dlen) {
+      free (wr->blk_buf);
+      wr->blk_buf = (char*)malloc (dlen);
+      wr->blk_cap = (wr->blk_buf != NULL) ? dlen : 0;
+      if (wr->blk_buf == NULL) return LZ32_EUNKNOWN;
+    }
+
+    if (wr->cmr_lvl >= LZ32_LEVEL_HIGH) res = lz32_compress_high ( src_ptr, &(slen), wr->blk_buf, &(dlen) );
+    else                                res = lz32_compress_fast ( src_ptr, &(slen), wr->blk_buf, &(dlen) );
+    if (res != LZ32_SUCCESS) return res;
+    if (slen != src_len) return LZ32_EUNKNOWN;
+  }
+
+/* -----  ----- */
+
+  static const char pad_buf[16];
+  size_t pad_len = lz32_ceil16 (key_len) - key_len;
+
+  if ( (fwrite ( key_ptr, 1, key_len, wr->fp ) != key_len) ||
+       (fwrite ( pad_buf, 1, pad_len, wr->fp ) != pad_len) ||
+       ((dlen != 0) && (fwrite ( wr->blk_buf, 1, dlen, wr->fp ) != dlen)) ) return LZ32_EUNKNOWN;
+
+  lz32k_entry ent;
+  ent.key_hash = xxh64_hash ( key_ptr, key_len );
+  ent.blk_off = wr->data_end + key_len + pad_len;
+  ent.blk_len = (u32t)dlen;
+  ent.raw_len = (u32t)src_len;
+  ent.key_len = (u32t)key_len;
+  ent.raw_chk = xxh64_hash_low32 ( src_ptr, src_len );
+
+  wr->data_end = ent.blk_off + dlen;
+
+  return lz32k_writer_push ( wr, &(ent), key_ptr );
+}
+
+
+/* ----------  ---------- */
+
+
+static int lz32k_wentry_cmp ( const void* lhs, const void* rhs ) {
+  const lz32k_wentry* a = (const lz32k_wentry*)lhs;
+  const lz32k_wentry* b = (const lz32k_wentry*)rhs;
+  if (a->ent.key_hash != b->ent.key_hash) return (a->ent.key_hash < b->ent.key_hash) ? -1 : 1;
+  return (a->seq > b->seq) ? -1 : ((a->seq < b->seq) ? 1 : 0);
+}
+
+
+/* Writes the index and footer, syncs and frees 'wr' */
+
+int lz32k_writer_close ( lz32k_writer* wr ) {
+
+  if (wr == NULL) return LZ32_EINVAL;
+
+  /* newest first within a hash, so the first copy of a key wins */
+
+  qsort ( wr->ent_ptr, wr->ent_cnt, sizeof (lz32k_wentry), lz32k_wentry_cmp );
+
+  size_t cnt = 0;
+  for (size_t k = 0; k < wr->ent_cnt; k++) {
+    const lz32k_wentry* cur = wr->ent_ptr + k;
+    int dup = 0;
+    for (size_t j = cnt; (j > 0) && (wr->ent_ptr[j - 1].ent.key_hash == cur->ent.key_hash); j--) {
+      const lz32k_wentry* old = wr->ent_ptr + (j - 1);
+      if ( (old->ent.key_len == cur->ent.key_len) &&
+           (memcmp ( (wr->key_buf + old->key_pos), (wr->key_buf + cur->key_pos), cur->ent.key_len ) == 0) ) { dup = 1; break; }
+    }
+    if (dup == 0) wr->ent_ptr[cnt++] = *(cur);
+  }
+
+/* -----  ----- */
+
+  static const char pad_buf[LZ32K_PAGE];
+  u64t idx_off = (wr->data_end + LZ32K_PAGE - 1) & ~((u64t)LZ32K_PAGE - 1);
+  size_t pad_len = (size_t)(idx_off - wr->data_end);
+  int ok = (fwrite ( pad_buf, 1, pad_len, wr->fp ) == pad_len);
+
+  for (size_t k = 0; ok && (k < cnt); k++) {
+    ok = (fwrite ( &(wr->ent_ptr[k].ent), sizeof (lz32k_entry), 1, wr->fp ) == 1);
+  }
+
+  for (size_t k = 0; ok && (k < cnt); k += LZ32K_PAGE_ENTRIES) {
+    char buf[8];
+    lz32_write64 ( buf, wr->ent_ptr[k].ent.key_hash );
+    ok = (fwrite ( buf, 1, 8, wr->fp ) == 8);
+  }
+
+  char foot[LZ32K_FOOT_LEN];
+  lz32_write64 ( (foot + 0), LZ32K_MAGIC );
+  lz32_write64 ( (foot + 8), (u64t)cnt );
+  lz32_write64 ( (foot + 16), idx_off );
+  lz32_write64 ( (foot + 24), wr->data_end );
+
+  /* the data and index are durable before the footer that points at them */
+
+  ok = ok && (fflush (wr->fp) == 0) && (fsync (fileno (wr->fp)) == 0);
+  ok = ok && (fwrite ( foot, 1, sizeof (foot), wr->fp ) == sizeof (foot));
+  ok = ok && (fflush (wr->fp) == 0) && (fsync (fileno (wr->fp)) == 0);
+  ok = (fclose (wr->fp) == 0) && ok;
+
+  free (wr->blk_buf);
+  free (wr->key_buf);
+  free (wr->ent_ptr);
+  free (wr);
+
+  return ok ? LZ32_SUCCESS : LZ32_EUNKNOWN;
+}
+
+
+/* ---------- Command line ---------- */
+
+
+static char* lz32k_load ( const char* path, size_t* len ) {
+
+  FILE* fp = fopen (path, "rb");
+  if (fp == NULL) return NULL;
+
+  char* buf = NULL;
+  long flen = -1;
+  if (fseek (fp, 0, SEEK_END) == 0) flen = ftell (fp);
+  if ((flen >= 0) && (fseek (fp, 0, SEEK_SET) == 0)) {
+    buf = (char*)malloc ((size_t)flen + 1);
+    if ((buf != NULL) && (fread (buf, 1, (size_t)flen, fp) != (size_t)flen)) {
+      free (buf); buf = NULL;
+    }
+  }
+
+  fclose (fp);
+  *(len) = (size_t)flen;
+  return buf;
+}
+
+
+static int lz32k_cmd_time ( const lz32k_pack* pk ) {
+
+  size_t cnt = pk->ent_cnt, raw_max = 1;
+  size_t* ord = (size_t*)malloc ( (cnt + 1) * sizeof (size_t) );
+  if (ord == NULL) return 1;
+
+  for (size_t k = 0; k < cnt; k++) {
+    ord[k] = k;
+    if (pk->ent_ptr[k].raw_len > raw_max) raw_max = pk->ent_ptr[k].raw_len;
+  }
+
+  u64t rng = 0x9E3779B97F4A7C15ULL;
+  for (size_t k = cnt; k > 1; k--) {
+    rng ^= rng << 13; rng ^= rng >> 7; rng ^= rng << 17;
+    size_t j = (size_t)(rng % k), t = ord[k - 1];
+    ord[k - 1] = ord[j]; ord[j] = t;
+  }
+
+  char* dst = (char*)malloc (raw_max);
+  if (dst == NULL) { free (ord); return 1; }
+
+  struct timespec t0, t1;
+  size_t bad = 0;
+  clock_gettime ( CLOCK_MONOTONIC, &(t0) );
+
+  for (size_t k = 0; k < cnt; k++) {
+    const lz32k_entry* ent = pk->ent_ptr + ord[k];
+    const char* key = pk->map_ptr + ent->blk_off - lz32_ceil16 (ent->key_len);
+    size_t dlen = raw_max;
+    if (lz32k_get ( pk, key, ent->key_len, dst, &(dlen) ) != LZ32_SUCCESS) bad += 1;
+  }
+
+  clock_gettime ( CLOCK_MONOTONIC, &(t1) );
+  double sec = (double)(t1.tv_sec - t0.tv_sec) + (double)(t1.tv_nsec - t0.tv_nsec) * 1e-9;
+  printf ( "%zu gets, %zu failed, %.0f ns per get\n", cnt, bad, (cnt != 0) ? (sec * 1e9 / (double)cnt) : 0.0 );
+
+  free (dst);
+  free (ord);
+  return (bad == 0) ? 0 : 1;
+}
+
+
+int main ( int argc, char** argv ) {
+
+  int level = LZ32_LEVEL_FAST, argi = 1;
+  if ((argi < argc) && (strcmp (argv[argi], "-f") == 0)) { level = LZ32_LEVEL_FAST; argi += 1; }
+  else if ((argi < argc) && (strcmp (argv[argi], "-h") == 0)) { level = LZ32_LEVEL_HIGH; argi += 1; }
+
+  const char* cmd = (argi < argc) ? argv[argi] : "";
+  const char* path = (argi + 1 < argc) ? argv[argi + 1] : NULL;
+  int res = 1;
+
+/* -----  ----- */
+
+  if ((strcmp (cmd, "-a") == 0) && (path != NULL)) {
+
+    lz32k_writer* wr = lz32k_writer_open ( path, level );
+    if (wr == NULL) { fprintf ( stderr, "lz32pack: cannot open '%s' for adding\n", path ); return EXIT_FAILURE; }
+
+    res = 0;
+    for (int i = argi + 2; i < argc; i++) {
+      size_t len = 0;
+      char* buf = lz32k_load ( argv[i], &(len) );
+      int err = (buf != NULL) ? lz32k_writer_add ( wr, argv[i], strlen (argv[i]), buf, len ) : LZ32_EINVAL;
+      if (err != LZ32_SUCCESS) { fprintf ( stderr, "lz32pack: skipped '%s'\n", argv[i] ); res = 1; }
+      free (buf);
+    }
+
+    if (lz32k_writer_close (wr) != LZ32_SUCCESS) { fprintf ( stderr, "lz32pack: cannot write '%s'\n", path ); res = 1; }
+    return (res == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+
+/* -----  ----- */
+
+  if (((strcmp (cmd, "-g") == 0) && (argi + 2 < argc)) || (((strcmp (cmd, "-l") == 0) || (strcmp (cmd, "-t") == 0)) && (path != NULL))) {
+
+    lz32k_pack* pk = lz32k_open (path);
+    if (pk == NULL) { fprintf ( stderr, "lz32pack: '%s' is not a pack file\n", path ); return EXIT_FAILURE; }
+
+    if (strcmp (cmd, "-g") == 0) {
+      const char* key = argv[argi + 2];
+      const lz32k_entry* ent = lz32k_find ( pk, key, strlen (key) );
+      char* dst = (ent != NULL) ? (char*)malloc (ent->raw_len) : NULL;
+      size_t dlen = (ent != NULL) ? ent->raw_len : 0;
+      if ((dst != NULL) && (lz32k_get ( pk, key, strlen (key), dst, &(dlen) ) == LZ32_SUCCESS)) {
+        res = (fwrite ( dst, 1, dlen, stdout ) == dlen) ? 0 : 1;
+      } else {
+        fprintf ( stderr, "lz32pack: '%s' %s\n", key, (ent == NULL) ? "not found" : "is damaged" );
+      }
+      free (dst);
+    }
+
+    if (strcmp (cmd, "-l") == 0) {
+      for (size_t k = 0; k < pk->ent_cnt; k++) {
+        const lz32k_entry* ent = pk->ent_ptr + k;
+        const char* key = pk->map_ptr + ent->blk_off - lz32_ceil16 (ent->key_len);
+        printf ( "%10u %10u  %.*s\n", (unsigned)ent->raw_len, (unsigned)ent->blk_len, (int)ent->key_len, key );
+      }
+      res = 0;
+    }
+
+    if (strcmp (cmd, "-t") == 0) res = lz32k_cmd_time (pk);
+
+    lz32k_close (pk);
+    return (res == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+
+/* -----  ----- */
+
+  fprintf ( stderr, "usage: %s [-f | -h] -a pack file...\n"
+                    "       %s -g pack key\n"
+                    "       %s -l pack\n"
+                    "       %s -t pack\n", argv[0], argv[0], argv[0], argv[0] );
+  return EXIT_FAILURE;
+}
+
@@ -0,0 +1,697 @@
+
+/* ---------- LZ32 asynchronous file compressor ---------- */
+
+/*
+ * Build : cc -O2 -pthread -o lz32pipe lz32pipe.c          (Linux 5.6+, io_uring)
+ * Usage : lz32pipe [-f | -h] [-t threads] [-c chunk_kb] [-q depth] [-s seg_kb] [-n segs] in out
+ *
+ *   -f, -h  lz32d_compress_fast (default) or lz32d_compress_high
+ *   -t      compression worker threads                       (default 4)
+ *   -c      raw chunk size per frame, in KB                  (default 1024)
+ *   -q      chunk slots: reads in flight + queued + being compressed + waiting for
+ *           the writer, so also the bound on the input side queue (default 2 * threads + 2)
+ *   -s, -n  size in KB and count of the output staging segments (default 4096 KB x 4)
+ *
+ * One I/O thread owns an io_uring: it keeps every free slot reading the next chunk,
+ * hands full chunks to the workers, appends finished frames to the output in chunk
+ * order and writes full staging segments with O_DIRECT. Workers signal completion
+ * through an eventfd whose read is itself queued on the ring, so the I/O thread only
+ * ever waits in io_uring_enter(). All memory is allocated up front and registered
+ * with the ring as fixed buffers; nothing is allocated while the pipeline runs.
+ */
+
+#define _GNU_SOURCE
+
+#include "lz32.c"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <linux/io_uring.h>
+
+
+/* ---------- Configuration ---------- */
+
+
+#define LZ32P_ALIGN 4096
+
+typedef struct lz32p_config {
+  int cmr_lvl;                  /* LZ32_LEVEL_FAST or LZ32_LEVEL_HIGH */
+  int thr_cnt;                  /* compression workers */
+  size_t chk_len;               /* raw bytes per frame */
+  size_t slot_cnt;              /* chunk slots (input queue bound) */
+  size_t seg_len;               /* output staging segment, multiple of LZ32P_ALIGN */
+  size_t seg_cnt;               /* output staging segments (write queue bound) */
+} lz32p_config;
+
+typedef struct lz32p_result {
+  unsigned long long raw_bytes;
+  unsigned long long out_bytes;
+  unsigned long long frames;
+  unsigned long long wrk_waits;         /* worker found no chunk to compress */
+  unsigned long long out_stalls;        /* finished frame found no free staging segment */
+} lz32p_result;
+
+
+/* ---------- io_uring ---------- */
+
+
+typedef struct lz32p_ring {
+  int fd;
+  unsigned ent_cnt;
+  unsigned* sq_head;
+  unsigned* sq_tail;
+  unsigned* sq_mask;
+  unsigned* sq_array;
+  struct io_uring_sqe* sqes;
+  unsigned* cq_head;
+  unsigned* cq_tail;
+  unsigned* cq_mask;
+  struct io_uring_cqe* cqes;
+  unsigned sq_pend;
+  void* sq_map; size_t sq_map_len;
+  void* cq_map; size_t cq_map_len;
+  size_t sqe_map_len;
+} lz32p_ring;
+
+
+static int lz32p_ring_init ( lz32p_ring* ring, unsigned ent_cnt ) {
+
+  struct io_uring_params prm;
+  memset ( &(prm), 0, sizeof (prm) );
+  memset ( ring, 0, sizeof (*ring) );
+
+  ring->fd = (int)syscall ( __NR_io_uring_setup, ent_cnt, &(prm) );
+  if (ring->fd < 0) return -1;
+
+  ring->ent_cnt = prm.sq_entries;
+  ring->sq_map_len = prm.sq_off.array + prm.sq_entries * sizeof (unsigned);
+  ring->cq_map_len = prm.cq_off.cqes + prm.cq_entries * sizeof (struct io_uring_cqe);
+  ring->sqe_map_len = prm.sq_entries * sizeof (struct io_uring_sqe);
+
+  if ((prm.features & IORING_FEAT_SINGLE_MMAP) != 0) {
+    if (ring->cq_map_len > ring->sq_map_len) ring->sq_map_len = ring->cq_map_len;
+  }
+
+  ring->sq_map = mmap ( NULL, ring->sq_map_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING );
+  if (ring->sq_map == MAP_FAILED) return -1;
+
+  if ((prm.features & IORING_FEAT_SINGLE_MMAP) != 0) {
+    ring->cq_map = ring->sq_map;
+  } else {
+    ring->cq_map = mmap ( NULL, ring->cq_map_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING );
+    if (ring->cq_map == MAP_FAILED) return -1;
+  }
+
+  ring->sqes = (struct io_uring_sqe*)mmap ( NULL, ring->sqe_map_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES );
+  if (ring->sqes == MAP_FAILED) return -1;
+
+  char* sq_ptr = (char*)ring->sq_map;
+  char* cq_ptr = (char*)ring->cq_map;
+
+  ring->sq_head  = (unsigned*)(sq_ptr + prm.sq_off.head);
+  ring->sq_tail  = (unsigned*)(sq_ptr + prm.sq_off.tail);
+  ring->sq_mask  = (unsigned*)(sq_ptr + prm.sq_off.ring_mask);
+  ring->sq_array = (unsigned*)(sq_ptr + prm.sq_off.array);
+  ring->cq_head  = (unsigned*)(cq_ptr + prm.cq_off.head);
+  ring->cq_tail  = (unsigned*)(cq_ptr + prm.cq_off.tail);
+  ring->cq_mask  = (unsigned*)(cq_ptr + prm.cq_off.ring_mask);
+  ring->cqes     = (struct io_uring_cqe*)(cq_ptr + prm.cq_off.cqes);
+
+  return 0;
+}
+
+
+static void lz32p_ring_free ( lz32p_ring* ring ) {
+  if ((ring->sqes != NULL) && (ring->sqes != MAP_FAILED)) munmap ( ring->sqes, ring->sqe_map_len );
+  if ((ring->cq_map != NULL) && (ring->cq_map != MAP_FAILED) && (ring->cq_map != ring->sq_map)) munmap ( ring->cq_map, ring->cq_map_len );
+  if ((ring->sq_map != NULL) && (ring->sq_map != MAP_FAILED)) munmap ( ring->sq_map, ring->sq_map_len );
+  if (ring->fd >= 0) close (ring->fd);
+}
+
+
+/* The pipeline never has more than ent_cnt requests in flight, so a slot is always free */
+
+static struct io_uring_sqe* lz32p_ring_sqe ( lz32p_ring* ring ) {
+
+  unsigned tail = *(ring->sq_tail);
+  unsigned idx = tail & *(ring->sq_mask);
+  struct io_uring_sqe* sqe = ring->sqes + idx;
+
+  memset ( sqe, 0, sizeof (*sqe) );
+  ring->sq_array[idx] = idx;
+  __atomic_store_n ( ring->sq_tail, tail + 1, __ATOMIC_RELEASE );
+  ring->sq_pend += 1;
+
+  return sqe;
+}
+
+
+static int lz32p_ring_enter ( lz32p_ring* ring, unsigned wait_cnt ) {
+
+  for (;;) {
+    int res = (int)syscall ( __NR_io_uring_enter, ring->fd, ring->sq_pend, wait_cnt,
+                             (wait_cnt != 0) ? IORING_ENTER_GETEVENTS : 0, NULL, 0 );
+    if (res >= 0) { ring->sq_pend -= (unsigned)res; return 0; }
+    if (errno != EINTR) return -1;
+  }
+}
+
+
+/* ---------- Pipeline state ---------- */
+
+
+enum { LZ32P_FREE, LZ32P_READING, LZ32P_WORKING, LZ32P_DONE };
+enum { LZ32P_OP_READ = 1, LZ32P_OP_WRITE = 2, LZ32P_OP_EVENT = 3 };
+
+#define LZ32P_TAG(op, idx) (((u64t)(op) << 32) | (u64t)(idx))
+
+typedef struct lz32p_slot {
+  int state;
+  u64t seq;
+  u64t raw_off;
+  size_t raw_len, raw_got;
+  size_t frm_len, frm_pos;
+  int res_val;
+  char* raw_buf;
+  char* frm_buf;
+} lz32p_slot;
+
+typedef struct lz32p_pipe {
+
+  lz32p_config cfg;
+  lz32p_ring ring;
+  int fixed_bufs;
+
+  int inp_fd, out_fd, evt_fd;
+  u64t inp_len, out_off, out_len;
+  u64t chk_cnt, seq_read, seq_out;
+
+  lz32p_slot* slot_ptr;
+  size_t frm_cap;
+
+  char* seg_buf;
+  int* seg_busy;
+  size_t seg_cur, seg_fill, seg_wrt;
+
+  /* worker side, all under 'mtx' */
+
+  pthread_mutex_t mtx;
+  pthread_cond_t cnd;
+  size_t* wrk_queue;
+  size_t wrk_head, wrk_cnt;
+  size_t* done_list;
+  size_t done_cnt;
+  int stop;
+
+  u64t evt_val;
+  lz32p_result res;
+
+} lz32p_pipe;
+
+
+/* ---------- Workers ---------- */
+
+
+static void* lz32p_worker ( void* arg ) {
+
+  lz32p_pipe* pip = (lz32p_pipe*)arg;
+
+  for (;;) {
+
+    pthread_mutex_lock (&(pip->mtx));
+    if ((pip->wrk_cnt == 0) && (pip->stop == 0)) pip->res.wrk_waits += 1;
+    while ((pip->wrk_cnt == 0) && (pip->stop == 0)) pthread_cond_wait ( &(pip->cnd), &(pip->mtx) );
+    if (pip->wrk_cnt == 0) { pthread_mutex_unlock (&(pip->mtx)); return NULL; }
+
+    size_t idx = pip->wrk_queue[pip->wrk_head];
+    pip->wrk_head = (pip->wrk_head + 1) % pip->cfg.slot_cnt;
+    pip->wrk_cnt -= 1;
+    pthread_mutex_unlock (&(pip->mtx));
+
+/* -----  ----- */
+
+    lz32p_slot* slot = pip->slot_ptr + idx;
+    size_t slen = slot->raw_len, dlen = pip->frm_cap;
+
+    if (pip->cfg.cmr_lvl >= LZ32_LEVEL_HIGH) slot->res_val = lz32d_compress_high ( slot->raw_buf, &(slen), slot->frm_buf, &(dlen) );
+    else                                     slot->res_val = lz32d_compress_fast ( slot->raw_buf, &(slen), slot->frm_buf, &(dlen) );
+    if ((slot->res_val == LZ32_SUCCESS) && (slen != slot->raw_len)) slot->res_val = LZ32_EUNKNOWN;
+    slot->frm_len = dlen;
+
+/* -----  ----- */
+
+    pthread_mutex_lock (&(pip->mtx));
+    pip->done_list[pip->done_cnt] = idx;
+    pip->done_cnt += 1;
+    pthread_mutex_unlock (&(pip->mtx));
+
+    u64t one = 1;
+    if (write ( pip->evt_fd, &(one), sizeof (one) ) < 0) { /* counter saturation only */ }
+  }
+}
+
+
+/* ---------- I/O thread ---------- */
+
+
+static void lz32p_submit_read ( lz32p_pipe* pip, size_t idx ) {
+
+  lz32p_slot* slot = pip->slot_ptr + idx;
+  struct io_uring_sqe* sqe = lz32p_ring_sqe (&(pip->ring));
+
+  sqe->opcode = pip->fixed_bufs ? IORING_OP_READ_FIXED : IORING_OP_READ;
+  sqe->fd = pip->inp_fd;
+  sqe->off = slot->raw_off + slot->raw_got;
+  sqe->addr = (u64t)(size_t)(slot->raw_buf + slot->raw_got);
+  sqe->len = (u32t)(slot->raw_len - slot->raw_got);
+  sqe->buf_index = (u16t)idx;
+  sqe->user_data = LZ32P_TAG (LZ32P_OP_READ, idx);
+}
+
+
+static void lz32p_submit_write ( lz32p_pipe* pip, size_t seg, size_t len ) {
+
+  struct io_uring_sqe* sqe = lz32p_ring_sqe (&(pip->ring));
+
+  sqe->opcode = pip->fixed_bufs ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE;
+  sqe->fd = pip->out_fd;
+  sqe->off = pip->out_off;
+  sqe->addr = (u64t)(size_t)(pip->seg_buf + seg * pip->cfg.seg_len);
+  sqe->len = (u32t)len;
+  sqe->buf_index = (u16t)(pip->cfg.slot_cnt + seg);
+  sqe->user_data = LZ32P_TAG (LZ32P_OP_WRITE, seg);
+
+  pip->seg_busy[seg] = 1;
+  pip->seg_wrt += 1;
+  pip->out_off += len;
+}
+
+
+static void lz32p_submit_event ( lz32p_pipe* pip ) {
+
+  struct io_uring_sqe* sqe = lz32p_ring_sqe (&(pip->ring));
+
+  sqe->opcode = IORING_OP_READ;
+  sqe->fd = pip->evt_fd;
+  sqe->addr = (u64t)(size_t)&(pip->evt_val);
+  sqe->len = sizeof (pip->evt_val);
+  sqe->user_data = LZ32P_TAG (LZ32P_OP_EVENT, 0);
+}
+
+
+/* Starts reads on free slots while chunks remain */
+
+static void lz32p_fill_reads ( lz32p_pipe* pip ) {
+
+  for (size_t idx = 0; (idx < pip->cfg.slot_cnt) && (pip->seq_read < pip->chk_cnt); idx++) {
+
+    lz32p_slot* slot = pip->slot_ptr + idx;
+    if (slot->state != LZ32P_FREE) continue;
+
+    u64t off = pip->seq_read * pip->cfg.chk_len;
+    u64t rem = pip->inp_len - off;
+
+    slot->state = LZ32P_READING;
+    slot->seq = pip->seq_read;
+    slot->raw_off = off;
+    slot->raw_len = (rem < pip->cfg.chk_len) ? (size_t)rem : pip->cfg.chk_len;
+    slot->raw_got = 0;
+    slot->frm_pos = 0;
+
+    pip->seq_read += 1;
+    lz32p_submit_read ( pip, idx );
+  }
+}
+
+
+/* Appends finished frames to the staging segments in chunk order; returns -1 on a failed frame */
+
+static int lz32p_drain_frames ( lz32p_pipe* pip ) {
+
+  for (;;) {
+
+    lz32p_slot* slot = NULL;
+    for (size_t idx = 0; idx < pip->cfg.slot_cnt; idx++) {
+      lz32p_slot* cur = pip->slot_ptr + idx;
+      if ((cur->state == LZ32P_DONE) && (cur->seq == pip->seq_out)) { slot = cur; break; }
+    }
+    if (slot == NULL) return 0;
+    if (slot->res_val != LZ32_SUCCESS) return -1;
+
+/* -----  ----- */
+
+    while (slot->frm_pos < slot->frm_len) {
+
+      if (pip->seg_busy[pip->seg_cur] != 0) { pip->res.out_stalls += 1; return 0; }
+
+      size_t cap = pip->cfg.seg_len - pip->seg_fill;
+      size_t len = slot->frm_len - slot->frm_pos;
+      if (len > cap) len = cap;
+
+      memcpy ( (pip->seg_buf + pip->seg_cur * pip->cfg.seg_len + pip->seg_fill), (slot->frm_buf + slot->frm_pos), len );
+      slot->frm_pos += len;
+      pip->seg_fill += len;
+
+      if (pip->seg_fill == pip->cfg.seg_len) {
+        lz32p_submit_write ( pip, pip->seg_cur, pip->cfg.seg_len );
+        pip->seg_cur = (pip->seg_cur + 1) % pip->cfg.seg_cnt;
+        pip->seg_fill = 0;
+      }
+    }
+
+/* -----  ----- */
+
+    pip->res.raw_bytes += slot->raw_len;
+    pip->res.out_bytes += slot->frm_len;
+    pip->res.frames += 1;
+    pip->out_len += slot->frm_len;
+
+    slot->state = LZ32P_FREE;
+    pip->seq_out += 1;
+  }
+}
+
+
+/* Handles one completion; returns -1 on an I/O error */
+
+static int lz32p_complete ( lz32p_pipe* pip, u64t tag, int cnt ) {
+
+  u32t op = (u32t)(tag >> 32);
+  size_t idx = (size_t)(u32t)tag;
+
+  if (op == LZ32P_OP_READ) {
+
+    lz32p_slot* slot = pip->slot_ptr + idx;
+    if (cnt <= 0) { errno = (cnt < 0) ? -cnt : EIO; return -1; }
+
+    slot->raw_got += (size_t)cnt;
+    if (slot->raw_got < slot->raw_len) { lz32p_submit_read ( pip, idx ); return 0; }
+
+    slot->state = LZ32P_WORKING;
+    pthread_mutex_lock (&(pip->mtx));
+    pip->wrk_queue[(pip->wrk_head + pip->wrk_cnt) % pip->cfg.slot_cnt] = idx;
+    pip->wrk_cnt += 1;
+    pthread_cond_signal (&(pip->cnd));
+    pthread_mutex_unlock (&(pip->mtx));
+    return 0;
+  }
+
+  if (op == LZ32P_OP_WRITE) {
+    if (cnt < 0) { errno = -cnt; return -1; }
+    pip->seg_busy[idx] = 0;
+    pip->seg_wrt -= 1;
+    return 0;
+  }
+
+  /* LZ32P_OP_EVENT */
+
+  pthread_mutex_lock (&(pip->mtx));
+  for (size_t k = 0; k < pip->done_cnt; k++) pip->slot_ptr[pip->done_list[k]].state = LZ32P_DONE;
+  pip->done_cnt = 0;
+  pthread_mutex_unlock (&(pip->mtx));
+
+  if (pip->seq_out < pip->chk_cnt) lz32p_submit_event (pip);
+  return 0;
+}
+
+
+static int lz32p_run ( lz32p_pipe* pip ) {
+
+  int fin_sent = 0;
+
+  lz32p_submit_event (pip);
+
+  for (;;) {
+
+    lz32p_fill_reads (pip);
+    if (lz32p_drain_frames (pip) != 0) { errno = EPROTO; return -1; }
+
+    /* the last segment is padded to the O_DIRECT alignment and trimmed afterwards */
+
+    if ((pip->seq_out == pip->chk_cnt) && (fin_sent == 0) && (pip->seg_busy[pip->seg_cur] == 0)) {
+      if (pip->seg_fill != 0) {
+        size_t len = (pip->seg_fill + LZ32P_ALIGN - 1) & ~((size_t)LZ32P_ALIGN - 1);
+        memset ( (pip->seg_buf + pip->seg_cur * pip->cfg.seg_len + pip->seg_fill), 0, len - pip->seg_fill );
+        lz32p_submit_write ( pip, pip->seg_cur, len );
+      }
+      fin_sent = 1;
+    }
+
+    if ((fin_sent != 0) && (pip->seg_wrt == 0)) break;
+
+/* -----  ----- */
+
+    if (lz32p_ring_enter ( &(pip->ring), 1 ) != 0) return -1;
+
+    unsigned head = *(pip->ring.cq_head);
+    unsigned tail = __atomic_load_n ( pip->ring.cq_tail, __ATOMIC_ACQUIRE );
+
+    while (head != tail) {
+      struct io_uring_cqe* cqe = pip->ring.cqes + (head & *(pip->ring.cq_mask));
+      u64t tag = cqe->user_data;
+      int cnt = cqe->res;
+      head += 1;
+      __atomic_store_n ( pip->ring.cq_head, head, __ATOMIC_RELEASE );
+      if (lz32p_complete ( pip, tag, cnt ) != 0) return -1;
+    }
+  }
+
+  if (ftruncate ( pip->out_fd, (off_t)pip->out_len ) != 0) return -1;
+  return 0;
+}
+
+
+/* ---------- Interface ---------- */
+
+
+void lz32p_config_default ( lz32p_config* cfg ) {
+  cfg->cmr_lvl = LZ32_LEVEL_FAST;
+  cfg->thr_cnt = 4;
+  cfg->chk_len = (size_t)1 << 20;
+  cfg->slot_cnt = 0;
+  cfg->seg_len = (size_t)4 << 20;
+  cfg->seg_cnt = 4;
+}
+
+
+/*
+ * Compresses 'inp_fd' (a regular file, read from offset 0) into a stream of lz32d frames
+ * on 'out_fd', written from offset 0 and truncated to the stream length. 'out_fd' may be
+ * opened with O_DIRECT. Returns 0, or -1 with errno set.
+ */
+
+int lz32p_compress_file ( int inp_fd, int out_fd, const lz32p_config* cfg_ptr, lz32p_result* res_ptr ) {
+
+  lz32p_pipe* pip = (lz32p_pipe*)calloc ( 1, sizeof (lz32p_pipe) );
+  if (pip == NULL) return -1;
+
+  pip->cfg = *(cfg_ptr);
+  pip->inp_fd = inp_fd;
+  pip->out_fd = out_fd;
+  pip->evt_fd = -1;
+  pip->ring.fd = -1;
+
+  lz32p_config* cfg = &(pip->cfg);
+  if (cfg->thr_cnt < 1) cfg->thr_cnt = 1;
+  if (cfg->slot_cnt == 0) cfg->slot_cnt = 2 * (size_t)cfg->thr_cnt + 2;
+  if (cfg->seg_cnt < 2) cfg->seg_cnt = 2;
+
+  int ret = -1, err = 0, thr_cnt = 0;
+  pthread_t* thr_ptr = NULL;
+  char* pool = NULL;
+  size_t pool_len = 0;
+
+  struct stat inp_st;
+  if (fstat ( inp_fd, &(inp_st) ) != 0) goto done;
+  if ( (cfg->chk_len < 1) || (cfg->chk_len > ((size_t)1 << 29)) ||
+       (cfg->seg_len < LZ32P_ALIGN) || (cfg->seg_len > ((size_t)1 << 30)) || ((cfg->seg_len % LZ32P_ALIGN) != 0) ||
+       (cfg->slot_cnt > 4096) || (cfg->seg_cnt > 4096) ) {
+    errno = EINVAL; goto done;
+  }
+
+  pip->inp_len = (u64t)inp_st.st_size;
+  pip->chk_cnt = (pip->inp_len + cfg->chk_len - 1) / cfg->chk_len;
+
+/* -----  ----- */
+
+  size_t slen = cfg->chk_len;
+  pip->frm_cap = cfg->chk_len + 64;
+  if (lz32d_compress_bound ( &(slen), &(pip->frm_cap) ) != LZ32_SUCCESS) { errno = EINVAL; goto done; }
+
+  size_t raw_cap = (cfg->chk_len + LZ32P_ALIGN - 1) & ~((size_t)LZ32P_ALIGN - 1);
+  size_t frm_cap = (pip->frm_cap + LZ32P_ALIGN - 1) & ~((size_t)LZ32P_ALIGN - 1);
+  pool_len = cfg->slot_cnt * (raw_cap + frm_cap) + cfg->seg_cnt * cfg->seg_len;
+
+  pool = (char*)mmap ( NULL, pool_len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0 );
+  if (pool == MAP_FAILED) { pool = NULL; goto done; }
+
+  pip->slot_ptr = (lz32p_slot*)calloc ( cfg->slot_cnt, sizeof (lz32p_slot) );
+  pip->wrk_queue = (size_t*)calloc ( cfg->slot_cnt, sizeof (size_t) );
+  pip->done_list = (size_t*)calloc ( cfg->slot_cnt, sizeof (size_t) );
+  pip->seg_busy = (int*)calloc ( cfg->seg_cnt, sizeof (int) );
+  thr_ptr = (pthread_t*)calloc ( (size_t)cfg->thr_cnt, sizeof (pthread_t) );
+  if ((pip->slot_ptr == NULL) || (pip->wrk_queue == NULL) || (pip->done_list == NULL) || (pip->seg_busy == NULL) || (thr_ptr == NULL)) goto done;
+
+  for (size_t idx = 0; idx < cfg->slot_cnt; idx++) {
+    pip->slot_ptr[idx].raw_buf = pool + idx * raw_cap;
+    pip->slot_ptr[idx].frm_buf = pool + cfg->slot_cnt * raw_cap + idx * frm_cap;
+  }
+  pip->seg_buf = pool + cfg->slot_cnt * (raw_cap + frm_cap);
+
+/* -----  ----- */
+
+  unsigned ent_cnt = 1;
+  while (ent_cnt < (cfg->slot_cnt + cfg->seg_cnt + 1)) ent_cnt <<= 1;
+  if (lz32p_ring_init ( &(pip->ring), ent_cnt ) != 0) goto done;
+
+  /* fixed buffers save the per-request page pinning; without them plain reads and writes work too */
+
+  struct iovec* iov = (struct iovec*)calloc ( cfg->slot_cnt + cfg->seg_cnt, sizeof (struct iovec) );
+  if (iov != NULL) {
+    for (size_t idx = 0; idx < cfg->slot_cnt; idx++) {
+      iov[idx].iov_base = pip->slot_ptr[idx].raw_buf;
+      iov[idx].iov_len = raw_cap;
+    }
+    for (size_t seg = 0; seg < cfg->seg_cnt; seg++) {
+      iov[cfg->slot_cnt + seg].iov_base = pip->seg_buf + seg * cfg->seg_len;
+      iov[cfg->slot_cnt + seg].iov_len = cfg->seg_len;
+    }
+    pip->fixed_bufs = (syscall ( __NR_io_uring_register, pip->ring.fd, IORING_REGISTER_BUFFERS,
+                                 iov, (unsigned)(cfg->slot_cnt + cfg->seg_cnt) ) == 0);
+    free (iov);
+  }
+
+  pip->evt_fd = eventfd ( 0, EFD_CLOEXEC );
+  if (pip->evt_fd < 0) goto done;
+
+/* -----  ----- */
+
+  pthread_mutex_init ( &(pip->mtx), NULL );
+  pthread_cond_init ( &(pip->cnd), NULL );
+
+  for (thr_cnt = 0; thr_cnt < cfg->thr_cnt; thr_cnt++) {
+    if (pthread_create ( (thr_ptr + thr_cnt), NULL, lz32p_worker, pip ) != 0) break;
+  }
+
+  if (thr_cnt != 0) ret = lz32p_run (pip);
+  err = errno;
+
+  pthread_mutex_lock (&(pip->mtx));
+  pip->stop = 1;
+  pthread_cond_broadcast (&(pip->cnd));
+  pthread_mutex_unlock (&(pip->mtx));
+
+  /* closing the ring cancels the armed eventfd read before the workers are gone */
+
+  lz32p_ring_free (&(pip->ring));
+  pip->ring.fd = -1; pip->ring.sq_map = NULL; pip->ring.cq_map = NULL; pip->ring.sqes = NULL;
+
+  for (int k = 0; k < thr_cnt; k++) pthread_join ( thr_ptr[k], NULL );
+
+  pthread_cond_destroy (&(pip->cnd));
+  pthread_mutex_destroy (&(pip->mtx));
+  errno = err;
+
+/* -----  ----- */
+
+done:
+
+  err = errno;
+  if (res_ptr != NULL) *(res_ptr) = pip->res;
+
+  lz32p_ring_free (&(pip->ring));
+  if (pip->evt_fd >= 0) close (pip->evt_fd);
+  if (pool != NULL) munmap ( pool, pool_len );
+  free (thr_ptr);
+  free (pip->seg_busy);
+  free (pip->done_list);
+  free (pip->wrk_queue);
+  free (pip->slot_ptr);
+  free (pip);
+
+  errno = err;
+  return ret;
+}
+
+
+/* ---------- Command line ---------- */
+
+
+static double lz32p_now ( void ) {
+  struct timespec ts;
+  clock_gettime ( CLOCK_MONOTONIC, &(ts) );
+  return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+
+int main ( int argc, char** argv ) {
+
+  lz32p_config cfg;
+  lz32p_config_default (&(cfg));
+  const char* inp_path = NULL;
+  const char* out_path = NULL;
+
+  for (int i = 1; i < argc; i++) {
+    if      (strcmp (argv[i], "-f") == 0) cfg.cmr_lvl = LZ32_LEVEL_FAST;
+    else if (strcmp (argv[i], "-h") == 0) cfg.cmr_lvl = LZ32_LEVEL_HIGH;
+    else if ((strcmp (argv[i], "-t") == 0) && (i + 1 < argc)) cfg.thr_cnt = atoi (argv[++i]);
+    else if ((strcmp (argv[i], "-c") == 0) && (i + 1 < argc)) cfg.chk_len = (size_t)strtoull (argv[++i], NULL, 10) << 10;
+    else if ((strcmp (argv[i], "-q") == 0) && (i + 1 < argc)) cfg.slot_cnt = (size_t)strtoull (argv[++i], NULL, 10);
+    else if ((strcmp (argv[i], "-s") == 0) && (i + 1 < argc)) cfg.seg_len = (size_t)strtoull (argv[++i], NULL, 10) << 10;
+    else if ((strcmp (argv[i], "-n") == 0) && (i + 1 < argc)) cfg.seg_cnt = (size_t)strtoull (argv[++i], NULL, 10);
+    else if ((argv[i][0] != '-') && (inp_path == NULL)) inp_path = argv[i];
+    else if ((argv[i][0] != '-') && (out_path == NULL)) out_path = argv[i];
+    else { out_path = NULL; break; }
+  }
+
+  if (out_path == NULL) {
+    fprintf ( stderr, "usage: %s [-f | -h] [-t threads] [-c chunk_kb] [-q depth] [-s seg_kb] [-n segs] in out\n", argv[0] );
+    return EXIT_FAILURE;
+  }
+
+/* -----  ----- */
+
+  int inp_fd = open ( inp_path, O_RDONLY | O_CLOEXEC );
+  if (inp_fd < 0) {
+    fprintf ( stderr, "lz32pipe: cannot open '%s': %s\n", inp_path, strerror (errno) );
+    return EXIT_FAILURE;
+  }
+
+  /* tmpfs and some network filesystems refuse O_DIRECT, the aligned writes work without it */
+
+  int out_fd = open ( out_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC | O_DIRECT, 0644 );
+  if ((out_fd < 0) && (errno == EINVAL)) out_fd = open ( out_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644 );
+  if (out_fd < 0) {
+    fprintf ( stderr, "lz32pipe: cannot create '%s': %s\n", out_path, strerror (errno) );
+    close (inp_fd);
+    return EXIT_FAILURE;
+  }
+
+  lz32p_result res;
+  double t0 = lz32p_now ();
+  int ret = lz32p_compress_file ( inp_fd, out_fd, &(cfg), &(res) );
+  double t1 = lz32p_now ();
+
+  if (ret != 0) fprintf ( stderr, "lz32pipe: compression failed: %s\n", strerror (errno) );
+  close (out_fd);
+  close (inp_fd);
+  if (ret != 0) return EXIT_FAILURE;
+
+  double sec = (t1 > t0) ? (t1 - t0) : 1e-9;
+  printf ( "%llu -> %llu bytes (%.3f) in %llu frames, %.3f s, %.1f MB/s\n",
+           res.raw_bytes, res.out_bytes,
+           (res.raw_bytes != 0) ? ((double)res.out_bytes / (double)res.raw_bytes) : 0.0,
+           res.frames, sec, (double)res.raw_bytes / sec / 1e6 );
+  printf ( "worker waits %llu, writer stalls %llu\n", res.wrk_waits, res.out_stalls );
+
+  return EXIT_SUCCESS;
+}
+